@@ -0,0 +1,110 @@
+#!/usr/bin/python
+# Convert SNR arc log files (_arc.lz4) to a table
+# The log files start with a JSON header (device status), followed by one record per completed
+# arc (see firmware_src/src/snrarc.h)
+#
+# usage: arcdecode.py LOGFILE_arc.lz4 [...] [-o OUTPUT.csv] [-s]
+# Prints (or writes) one row per point, or with -s one row per arc
+
+import sys
+import struct
+import argparse
+from datetime import datetime,timezone
+from lz4index import decompress
+from pvtdecode import skip_jsonheader
+
+SNRARC_SYNC=b'\xa5A'
+SNRARC_RISING=0x01
+SNRARC_SETTING=0x02
+SNRARC_CONTINUED=0x04
+
+#record layouts per version: header and point
+LAYOUTS={
+    1:('<2sBBHBHIHH','<HBH')
+}
+
+POINT_COLUMNS=['arc','time','sv','signal','direction','elevation','cn0']
+ARC_COLUMNS=['arc','start','end','sv','signal','direction','continued','npoints','elev_min','elev_max','azimuth0','azimuth1']
+
+class Arc:
+    def __init__(self,sv,signal,flags,utc,azimuth0,azimuth1,t,elevation,cn0):
+        self.sv=sv
+        self.signal=signal
+        self.flags=flags
+        self.utc=utc
+        self.azimuth0=azimuth0
+        self.azimuth1=azimuth1
+        self.t=t #seconds since the start of the arc
+        self.elevation=elevation #degrees
+        self.cn0=cn0 #dB-Hz
+
+    @property
+    def direction(self):
+        if self.flags & SNRARC_RISING:
+            return 'rising'
+        if self.flags & SNRARC_SETTING:
+            return 'setting'
+        return ''
+
+def isotime(utc):
+    return datetime.fromtimestamp(utc,tz=timezone.utc).isoformat()
+
+def decode_arcs(data):
+    """Returns a list of arcs"""
+    arcs=[]
+    offset=skip_jsonheader(data)
+    while offset+3 <= len(data):
+        sync,version=struct.unpack_from('<2sB',data,offset)
+        if sync != SNRARC_SYNC or version not in LAYOUTS:
+            raise ValueError(f"No valid SNR arc at offset {offset}")
+        hdrfmt,ptfmt=LAYOUTS[version]
+        hdrsize=struct.calcsize(hdrfmt)
+        ptsize=struct.calcsize(ptfmt)
+        if offset+hdrsize > len(data):
+            break
+        _,_,flags,sv,signal,npoints,utc,azimuth0,azimuth1=struct.unpack_from(hdrfmt,data,offset)
+        if offset+hdrsize+npoints*ptsize > len(data):
+            #truncated arc at the end of an unfinished file
+            break
+        points=[struct.unpack_from(ptfmt,data,offset+hdrsize+i*ptsize) for i in range(npoints)]
+        arcs.append(Arc(sv,signal,flags,utc,azimuth0,azimuth1,[p[0] for p in points],[p[1] for p in points],[p[2]*0.1 for p in points]))
+        offset+=hdrsize+npoints*ptsize
+    return arcs
+
+def read_arcs(logfile):
+    if logfile.endswith('.lz4'):
+        data=bytes(decompress(logfile))
+    else:
+        with open(logfile,'rb') as fid:
+            data=fid.read()
+    return decode_arcs(data)
+
+def main(argv):
+    parser=argparse.ArgumentParser(description="Convert SNR arc log files to a table")
+    parser.add_argument('logfiles',nargs='+',help="arc log files (lz4 compressed or not)")
+    parser.add_argument('-o','--output',help="output CSV file (default: stdout)")
+    parser.add_argument('-s','--summary',action='store_true',help="one row per arc instead of one row per point")
+    args=parser.parse_args(argv)
+
+    arcs=[]
+    for logfile in args.logfiles:
+        arcs.extend(read_arcs(logfile))
+
+    fid=open(args.output,'w') if args.output else sys.stdout
+    if args.summary:
+        fid.write(','.join(ARC_COLUMNS)+'\n')
+        for i,arc in enumerate(arcs):
+            row=[i,isotime(arc.utc),isotime(arc.utc+arc.t[-1]),arc.sv,arc.signal,arc.direction,int(bool(arc.flags & SNRARC_CONTINUED)),
+                len(arc.t),min(arc.elevation),max(arc.elevation),arc.azimuth0,arc.azimuth1]
+            fid.write(','.join(str(v) for v in row)+'\n')
+    else:
+        fid.write(','.join(POINT_COLUMNS)+'\n')
+        for i,arc in enumerate(arcs):
+            for t,elevation,cn0 in zip(arc.t,arc.elevation,arc.cn0):
+                row=[i,isotime(arc.utc+t),arc.sv,arc.signal,arc.direction,elevation,round(cn0,1)]
+                fid.write(','.join(str(v) for v in row)+'\n')
+    if args.output:
+        fid.close()
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
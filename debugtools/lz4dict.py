@@ -0,0 +1,117 @@
+#!/usr/bin/python
+# Train a preset lz4 dictionary for the logger from existing (decompressed) NMEA archives
+# The resulting file should be copied to the config directory of the sdcard as nmea.dict
+#
+# The dictionary is built greedily from whole sentences: each candidate sentence is scored by
+# how often its d-mers (substrings of length d) occur in the training data, not counting
+# d-mers which are already covered by the dictionary. The best sentences are placed at the
+# end of the dictionary, closest to the compressed data.
+#
+# usage: lz4dict.py [-s SIZE] [-o nmea.dict] ARCHIVE.lz4 [ARCHIVE.lz4 ...]
+
+import sys
+import argparse
+import heapq
+import random
+from collections import Counter
+import lz4.block
+from lz4index import decompress
+
+DMER=8
+
+def load_sentences(files,maxbytes,dictionary=b''):
+    """Collect the NMEA sentences from the archives (up to maxbytes of data)"""
+    sentences=[]
+    nbytes=0
+    for f in files:
+        data=decompress(f,dictionary) if f.endswith('.lz4') else open(f,'rb').read()
+        for line in data.splitlines(keepends=True):
+            if not line.startswith(b'$'):
+                #skip JSON headers and other records
+                continue
+            sentences.append(line)
+            nbytes+=len(line)
+            if nbytes >= maxbytes:
+                return sentences
+    return sentences
+
+def dmers(sentence):
+    return {sentence[i:i+DMER] for i in range(len(sentence)-DMER+1)}
+
+def train(sentences,dictsize):
+    """Greedy selection of sentences which cover the most frequent d-mers"""
+    freq=Counter()
+    for s in sentences:
+        freq.update(dmers(s))
+
+    candidates=list(set(sentences))
+    covered=set()
+    def score(s):
+        return sum(freq[d] for d in dmers(s) if d not in covered)
+
+    #lazy greedy: scores only decrease when more d-mers get covered
+    heap=[(-score(s),i) for i,s in enumerate(candidates)]
+    heapq.heapify(heap)
+    chosen=[]
+    size=0
+    while heap and size < dictsize:
+        negscore,i=heapq.heappop(heap)
+        s=candidates[i]
+        current=score(s)
+        if current == 0:
+            break
+        if heap and current < -heap[0][0]:
+            #stale score: put back with the updated value
+            heapq.heappush(heap,(-current,i))
+            continue
+        if size+len(s) > dictsize:
+            continue
+        chosen.append(s)
+        size+=len(s)
+        covered.update(dmers(s))
+
+    #most valuable sentences last
+    return b''.join(reversed(chosen))
+
+def evaluate(sentences,dictionary,chunksize=4096):
+    """Compressed size of the sentences in independent chunks, without and with dictionary"""
+    data=b''.join(sentences)
+    plain=withdict=0
+    for i in range(0,len(data),chunksize):
+        chunk=data[i:i+chunksize]
+        plain+=len(lz4.block.compress(chunk,store_size=False))
+        withdict+=len(lz4.block.compress(chunk,store_size=False,dict=dictionary))
+    return len(data),plain,withdict
+
+if __name__ == "__main__":
+    parser=argparse.ArgumentParser(description="Train a preset lz4 dictionary from NMEA archives")
+    parser.add_argument('archives',nargs='+',help="lz4 log files (or plain text NMEA files)")
+    parser.add_argument('-s','--size',type=int,default=4096,help="dictionary size (default 4096, see CONFIG_LZ4STREAM_DICT_MAX_SIZE)")
+    parser.add_argument('-o','--output',default='nmea.dict',help="output dictionary (default nmea.dict)")
+    parser.add_argument('-m','--maxbytes',type=int,default=4000000,help="maximum amount of training data")
+    parser.add_argument('-D','--dictionary',help="dictionary which was used to compress the archives")
+    args=parser.parse_args()
+
+    olddict=b''
+    if args.dictionary:
+        with open(args.dictionary,'rb') as fid:
+            olddict=fid.read()
+
+    sentences=load_sentences(args.archives,args.maxbytes,olddict)
+    if not sentences:
+        sys.exit("No NMEA sentences found")
+
+    #keep a part of the data apart for evaluation
+    random.seed(42)
+    ntest=len(sentences)//10
+    start=random.randrange(0,len(sentences)-ntest+1)
+    test=sentences[start:start+ntest]
+    training=sentences[:start]+sentences[start+ntest:]
+
+    dictionary=train(training,args.size)
+    with open(args.output,'wb') as fid:
+        fid.write(dictionary)
+
+    nbytes,plain,withdict=evaluate(test,dictionary)
+    print(f"Wrote {len(dictionary)} byte dictionary to {args.output} (trained on {len(training)} sentences)")
+    print(f"Held out data: {nbytes} bytes, 4 KiB chunks compress to {plain} bytes without and {withdict} bytes with dictionary")
@@ -0,0 +1,123 @@
+#!/usr/bin/python
+# Extract a time window from an indexed lz4 log file without decompressing the whole file
+# The logger writes an index sidecar (<logfile>.idx) which maps the UTC start time of
+# (independent) lz4 blocks to their offset in the log file
+#
+# usage: lz4index.py LOGFILE.lz4 START END [-o OUTPUT] [-D DICTIONARY]
+# START and END are UTC times in ISO format, e.g. 2026-10-17T10:00:00
+
+import sys
+import struct
+import argparse
+from datetime import datetime,timezone
+import lz4.block
+
+INDEX_MAGIC=b'L4IX'
+FRAME_MAGIC=0x184D2204
+
+def read_index(idxfile):
+    """Returns the index interval and a list of (utc,offset) tuples"""
+    with open(idxfile,'rb') as fid:
+        data=fid.read()
+    magic,version,interval=struct.unpack_from('<4sB3xI',data)
+    if magic != INDEX_MAGIC or version != 1:
+        raise ValueError(f"{idxfile} is not a supported lz4 index file")
+    hdrsize=struct.calcsize('<4sB3xI')
+    nentries=(len(data)-hdrsize)//8
+    entries=[struct.unpack_from('<II',data,hdrsize+i*8) for i in range(nentries)]
+    return interval,entries
+
+def read_frameheader(fid):
+    """Parse the lz4 frame header and return the header size, maximum block size, block checksum size, 
+    whether blocks are independent and the dictionary ID"""
+    hdr=fid.read(19)
+    magic,flg,bd=struct.unpack_from('<IBB',hdr)
+    if magic != FRAME_MAGIC:
+        raise ValueError("Not an lz4 frame")
+    hdrsize=7+(8 if flg & 0x08 else 0)+(4 if flg & 0x01 else 0)
+    dictid=struct.unpack_from('<I',hdr,hdrsize-5)[0] if flg & 0x01 else 0
+    blockmax=1 << (8+2*((bd >> 4) & 0x07))
+    checksumsize=4 if flg & 0x10 else 0
+    independent=bool(flg & 0x20)
+    return hdrsize,blockmax,checksumsize,independent,dictid
+
+def decode_blocks(fid,start,end,blockmax,checksumsize,independent=True,dictionary=b''):
+    """decode the blocks between the file offsets start and end (linked blocks must start at the first block)"""
+    fid.seek(start)
+    out=bytearray()
+    offset=start
+    while end is None or offset < end:
+        blkhdr=fid.read(4)
+        if len(blkhdr) < 4:
+            break
+        blocksize,=struct.unpack('<I',blkhdr)
+        if blocksize == 0:
+            #end mark
+            break
+        uncompressed=blocksize & 0x80000000
+        blocksize&=0x7FFFFFFF
+        data=fid.read(blocksize)
+        if len(data) < blocksize:
+            break
+        if uncompressed:
+            out+=data
+        else:
+            #linked blocks may refer to the previous 64 KB of data (which starts with the dictionary)
+            window=dictionary if independent else (dictionary+out[-65536:])[-65536:]
+            out+=lz4.block.decompress(data,uncompressed_size=blockmax,dict=bytes(window))
+        fid.seek(checksumsize,1)
+        offset+=4+blocksize+checksumsize
+    return bytes(out)
+
+def decompress(lz4file,dictionary=b''):
+    """Decompress a complete lz4 log file (possibly compressed with a preset dictionary)"""
+    with open(lz4file,'rb') as fid:
+        hdrsize,blockmax,checksumsize,independent,dictid=read_frameheader(fid)
+        if dictid and not dictionary:
+            raise ValueError(f"{lz4file} requires dictionary {dictid:08x}")
+        return decode_blocks(fid,hdrsize,None,blockmax,checksumsize,independent,dictionary)
+
+def extract(lz4file,tstart,tend,idxfile=None,dictionary=b''):
+    """Return the decompressed data which covers the UTC interval [tstart,tend] (unix times)"""
+    if idxfile is None:
+        idxfile=lz4file+".idx"
+    interval,entries=read_index(idxfile)
+    if not entries:
+        return b''
+    #first block starting at or before tstart (one block earlier, since marks are accurate to an epoch)
+    i0=max(0,max([i for i,(utc,_) in enumerate(entries) if utc <= tstart],default=0)-1)
+    #first block starting after tend
+    i1=next((i for i,(utc,_) in enumerate(entries) if utc > tend),None)
+    with open(lz4file,'rb') as fid:
+        hdrsize,blockmax,checksumsize,independent,dictid=read_frameheader(fid)
+        if not independent:
+            raise ValueError("lz4 file has linked blocks, which can not be decoded independently")
+        if dictid and not dictionary:
+            raise ValueError(f"{lz4file} requires dictionary {dictid:08x}")
+        end=entries[i1][1] if i1 is not None else None
+        return decode_blocks(fid,entries[i0][1],end,blockmax,checksumsize,True,dictionary)
+
+def parse_utc(tstr):
+    return int(datetime.fromisoformat(tstr).replace(tzinfo=timezone.utc).timestamp())
+
+if __name__ == "__main__":
+    parser=argparse.ArgumentParser(description="Extract a time window from an indexed lz4 log")
+    parser.add_argument('lz4file')
+    parser.add_argument('start',help="UTC start time (ISO format)")
+    parser.add_argument('end',help="UTC end time (ISO format)")
+    parser.add_argument('-i','--index',help="index file (default: LZ4FILE.idx)")
+    parser.add_argument('-o','--output',help="output file (default: stdout)")
+    parser.add_argument('-D','--dictionary',help="preset dictionary used by the logger")
+    args=parser.parse_args()
+
+    dictionary=b''
+    if args.dictionary:
+        with open(args.dictionary,'rb') as fid:
+            dictionary=fid.read()
+
+    data=extract(args.lz4file,parse_utc(args.start),parse_utc(args.end),args.index,dictionary)
+    if args.output:
+        with open(args.output,'wb') as fout:
+            fout.write(data)
+    else:
+        sys.stdout.buffer.write(data)
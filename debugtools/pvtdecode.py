@@ -0,0 +1,194 @@
+#!/usr/bin/python
+# Convert binary PVT log files (written with "log_mode": 1) to tables
+# The log files start with a JSON header (device status), followed by PVT records with a versioned
+# layout (see firmware_src/src/pvtrecord.h), or by columnar blocks of PVT records
+# (see firmware_src/src/pvtcolumns.h)
+#
+# usage: pvtdecode.py LOGFILE_pvt.lz4 [...] [-o PREFIX]
+# Prints the satellite table as CSV, or writes PREFIX_epochs.csv and PREFIX_sv.csv
+
+import sys
+import json
+import struct
+import argparse
+from datetime import datetime,timezone
+from lz4index import decompress
+
+PVTREC_SYNC=b'\xa5P'
+PVTCOL_SYNC=b'\xa5C'
+
+#record layouts per version: header and satellite entry
+LAYOUTS={
+    1:('<2sBBIHBiiiH','<HBHbHB')
+}
+
+EPOCH_COLUMNS=['time','flags','latitude','longitude','altitude','accuracy','nsv']
+SV_COLUMNS=['time','sv','signal','cn0','elevation','azimuth','flags']
+
+def skip_jsonheader(data):
+    """Returns the offset of the first record after the JSON header"""
+    if not data.startswith(b'{'):
+        return 0
+    text=data.decode('latin-1')
+    header,end=json.JSONDecoder().raw_decode(text)
+    while end < len(data) and data[end:end+1].isspace():
+        end+=1
+    return end
+
+def epoch_time(utc,ms):
+    return datetime.fromtimestamp(utc+ms/1000,tz=timezone.utc).isoformat()
+
+class BlockReader:
+    """Reads the variable length integers of a columnar block"""
+    def __init__(self,data,offset):
+        self.data=data
+        self.offset=offset
+
+    def byte(self):
+        if self.offset >= len(self.data):
+            raise EOFError
+        val=self.data[self.offset]
+        self.offset+=1
+        return val
+
+    def varint(self):
+        val=0
+        shift=0
+        while True:
+            byte=self.byte()
+            val|=(byte & 0x7f) << shift
+            shift+=7
+            if byte < 0x80:
+                return val
+
+    def zigzag(self):
+        val=self.varint()
+        return (val >> 1) ^ -(val & 1)
+
+    def deltas(self,n,wrap=None):
+        """column of n values stored as differences with the previous value"""
+        vals=[]
+        prev=0
+        for _ in range(n):
+            prev+=self.zigzag()
+            if wrap:
+                prev%=wrap
+            else:
+                #the firmware takes the differences modulo 2^32
+                prev=(prev+2**31)%2**32-2**31
+            vals.append(prev)
+        return vals
+
+    def xors(self,n):
+        vals=[]
+        prev=0
+        for _ in range(n):
+            prev^=self.byte()
+            vals.append(prev)
+        return vals
+
+def decode_block(data,offset,epochs,sats):
+    """Decode a columnar block of PVT records and return the offset after it"""
+    rd=BlockReader(data,offset+2)
+    version=rd.byte()
+    if version != 1:
+        raise ValueError(f"Unsupported PVT block version {version} at offset {offset}")
+    nepochs=rd.byte()
+    nsats=rd.byte()
+    utc=rd.deltas(nepochs)
+    ms=rd.deltas(nepochs)
+    lat=rd.deltas(nepochs)
+    lon=rd.deltas(nepochs)
+    alt=rd.deltas(nepochs)
+    accuracy=rd.deltas(nepochs)
+    flags=rd.xors(nepochs)
+    table=[]
+    for _ in range(nsats):
+        sv=rd.varint()
+        signal=rd.byte()
+        bitmap=bytes(rd.byte() for _ in range((nepochs+7)//8))
+        table.append((sv,signal,[e for e in range(nepochs) if bitmap[e//8] & (1 << (e%8))]))
+    rows=[]
+    for sv,signal,tracked in table:
+        n=len(tracked)
+        cn0=rd.deltas(n)
+        elevation=rd.deltas(n)
+        azimuth=rd.deltas(n,wrap=360)
+        svflags=rd.xors(n)
+        for i,e in enumerate(tracked):
+            rows.append((e,sv,signal,cn0[i],elevation[i],azimuth[i],svflags[i]))
+    #restore the order of the records: by epoch, satellites in the order of the table
+    rows.sort(key=lambda row:row[0])
+    times=[epoch_time(utc[e],ms[e]) for e in range(nepochs)]
+    nsv=[0]*nepochs
+    for e,sv,signal,cn0,elevation,azimuth,svf in rows:
+        nsv[e]+=1
+        sats.append([times[e],sv,signal,round(cn0*0.1,1),elevation,azimuth,svf])
+    for e in range(nepochs):
+        epochs.append([times[e],flags[e],round(lat[e]*1e-7,7),round(lon[e]*1e-7,7),round(alt[e]*1e-3,3),round(accuracy[e]*1e-2,2),nsv[e]])
+    return rd.offset
+
+def decode_records(data):
+    """Returns lists of epoch rows and satellite rows"""
+    epochs=[]
+    sats=[]
+    offset=skip_jsonheader(data)
+    while offset+4 <= len(data):
+        sync,version,nsv=struct.unpack_from('<2sBB',data,offset)
+        if sync == PVTCOL_SYNC:
+            try:
+                offset=decode_block(data,offset,epochs,sats)
+            except EOFError:
+                #truncated block at the end of an unfinished file
+                break
+            continue
+        if sync != PVTREC_SYNC or version not in LAYOUTS:
+            raise ValueError(f"No valid PVT record at offset {offset}")
+        hdrfmt,svfmt=LAYOUTS[version]
+        hdrsize=struct.calcsize(hdrfmt)
+        svsize=struct.calcsize(svfmt)
+        if offset+hdrsize+nsv*svsize > len(data):
+            #truncated record at the end of an unfinished file
+            break
+        _,_,_,utc,ms,flags,lat,lon,alt,accuracy=struct.unpack_from(hdrfmt,data,offset)
+        time=epoch_time(utc,ms)
+        epochs.append([time,flags,round(lat*1e-7,7),round(lon*1e-7,7),round(alt*1e-3,3),round(accuracy*1e-2,2),nsv])
+        for i in range(nsv):
+            sv,signal,cn0,elevation,azimuth,svflags=struct.unpack_from(svfmt,data,offset+hdrsize+i*svsize)
+            sats.append([time,sv,signal,round(cn0*0.1,1),elevation,azimuth,svflags])
+        offset+=hdrsize+nsv*svsize
+    return epochs,sats
+
+def write_csv(fid,columns,rows):
+    fid.write(','.join(columns)+'\n')
+    for row in rows:
+        fid.write(','.join(str(v) for v in row)+'\n')
+
+def main(argv):
+    parser=argparse.ArgumentParser(description="Convert binary PVT log files to tables")
+    parser.add_argument('logfiles',nargs='+',help="PVT log files (lz4 compressed or not)")
+    parser.add_argument('-o','--output',help="prefix of the output files (default: satellite table to stdout)")
+    args=parser.parse_args(argv)
+
+    epochs=[]
+    sats=[]
+    for logfile in args.logfiles:
+        if logfile.endswith('.lz4'):
+            data=bytes(decompress(logfile))
+        else:
+            with open(logfile,'rb') as fid:
+                data=fid.read()
+        ep,sv=decode_records(data)
+        epochs.extend(ep)
+        sats.extend(sv)
+
+    if args.output:
+        with open(args.output+'_epochs.csv','w') as fid:
+            write_csv(fid,EPOCH_COLUMNS,epochs)
+        with open(args.output+'_sv.csv','w') as fid:
+            write_csv(fid,SV_COLUMNS,sats)
+    else:
+        write_csv(sys.stdout,SV_COLUMNS,sats)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
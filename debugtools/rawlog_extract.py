@@ -0,0 +1,177 @@
+#!/usr/bin/python
+# Rebuild the lz4 log files from an image of an sdcard whose logs were written to the raw log
+# partition (CONFIG_GNSSR_RAWLOG, see firmware_src/src/rawlog.h)
+# The partition is a ring of 512 byte sectors, each with a header (magic, sequence number, file id,
+# sector number within the file, payload size, flags and a crc32) followed by the payload.
+# The first sector of a file starts with its name, the last sector of a closed file is flagged.
+#
+# usage: rawlog_extract.py IMAGE [-o OUTPUTDIR] [--offset SECTOR --sectors N] [-l]
+# The image can be made with e.g. dd if=/dev/sdX of=card.img bs=1M
+# Files which were not closed are recovered up to their last complete lz4 block (as the logger does
+# for files on the FAT partition after a reset)
+
+import os
+import sys
+import struct
+import zlib
+import argparse
+
+SECTOR_SIZE=512
+PART_TYPE=0xDA
+MAGIC=0x31474c52
+HEADER=struct.Struct('<IIIIHBBI')
+PAYLOAD=SECTOR_SIZE-HEADER.size
+FIRST=0x01
+LAST=0x02
+
+FRAME_MAGIC=0x184D2204
+
+def find_partition(fid):
+    """Returns the first sector and size (in sectors) of the raw log partition from the MBR"""
+    fid.seek(0)
+    mbr=fid.read(SECTOR_SIZE)
+    if len(mbr) < SECTOR_SIZE or mbr[510:512] != b'\x55\xaa':
+        raise ValueError("image does not start with an MBR")
+    for i in range(4):
+        entry=mbr[446+16*i:446+16*(i+1)]
+        if entry[4] == PART_TYPE:
+            return struct.unpack_from('<II',entry,8)
+    raise ValueError(f"no partition of type {PART_TYPE:#x} in the MBR")
+
+def read_sectors(fid,start,nsectors):
+    """Returns a dictionary of the valid sectors by file id, each a list of (index,seq,flags,payload)"""
+    files={}
+    fid.seek(start*SECTOR_SIZE)
+    for pos in range(nsectors):
+        sct=fid.read(SECTOR_SIZE)
+        if len(sct) < SECTOR_SIZE:
+            break
+        magic,seq,fileid,index,nbytes,flags,_,crc=HEADER.unpack_from(sct)
+        if magic != MAGIC or nbytes > PAYLOAD or seq%nsectors != pos:
+            continue
+        payload=sct[HEADER.size:HEADER.size+nbytes]
+        if zlib.crc32(payload,zlib.crc32(sct[:HEADER.size-4])) != crc:
+            continue
+        files.setdefault(fileid,[]).append((index,seq,flags,payload))
+    return files
+
+def assemble(sectors):
+    """Returns the name, data and whether the file was closed, or None when its start was overwritten"""
+    sectors.sort()
+    index,_,flags,payload=sectors[0]
+    if index != 0 or not flags & FIRST:
+        return None
+    name,_,data=payload.partition(b'\0')
+    data=bytearray(data)
+    closed=False
+    for i,(index,_,flags,payload) in enumerate(sectors[1:]):
+        if index != sectors[i][0]+1:
+            #a gap: part of the file was overwritten
+            break
+        data+=payload
+    else:
+        closed=bool(sectors[-1][2] & LAST)
+    return name.decode(errors='replace'),bytes(data),closed
+
+def xxh32(data,seed=0):
+    """xxHash32 (only used for the lz4 frame header checksum)"""
+    P1,P2,P3,P4,P5=2654435761,2246822519,3266489917,668265263,374761393
+    M=0xFFFFFFFF
+    rotl=lambda x,r: ((x << r) | (x >> (32-r))) & M
+    n=len(data)
+    i=0
+    if n >= 16:
+        v=[(seed+P1+P2) & M,(seed+P2) & M,seed,(seed-P1) & M]
+        while i+16 <= n:
+            for j in range(4):
+                lane,=struct.unpack_from('<I',data,i+4*j)
+                v[j]=(rotl((v[j]+lane*P2) & M,13)*P1) & M
+            i+=16
+        h=(rotl(v[0],1)+rotl(v[1],7)+rotl(v[2],12)+rotl(v[3],18)) & M
+    else:
+        h=(seed+P5) & M
+    h=(h+n) & M
+    while i+4 <= n:
+        lane,=struct.unpack_from('<I',data,i)
+        h=(rotl((h+lane*P3) & M,17)*P4) & M
+        i+=4
+    while i < n:
+        h=(rotl((h+data[i]*P5) & M,11)*P1) & M
+        i+=1
+    h^=h >> 15
+    h=(h*P2) & M
+    h^=h >> 13
+    h=(h*P3) & M
+    h^=h >> 16
+    return h
+
+def recover(data):
+    """End an unfinished lz4 frame after its last complete block"""
+    magic,flg,bd=struct.unpack_from('<IBB',data)
+    if magic != FRAME_MAGIC:
+        raise ValueError("not an lz4 frame")
+    hdrsize=7+(8 if flg & 0x08 else 0)+(4 if flg & 0x01 else 0)
+    checksumsize=4 if flg & 0x10 else 0
+    offset=hdrsize
+    while offset+4 <= len(data):
+        blocksize,=struct.unpack_from('<I',data,offset)
+        blocksize&=0x7FFFFFFF
+        if blocksize == 0:
+            #the frame was already finished
+            return data
+        if offset+4+blocksize+checksumsize > len(data):
+            break
+        offset+=4+blocksize+checksumsize
+    header=bytearray(data[:hdrsize])
+    if flg & 0x04:
+        #the content checksum cannot be computed without decompressing: drop it from the header
+        header[4]=flg & ~0x04
+        header[-1]=(xxh32(bytes(header[4:-1])) >> 8) & 0xFF
+    return bytes(header)+data[hdrsize:offset]+b'\0\0\0\0'
+
+def unique(path):
+    """Don't overwrite files with the same name (e.g. after the clock was reset)"""
+    base,ext=os.path.splitext(path)
+    n=1
+    while os.path.exists(path):
+        path=f"{base}_{n}{ext}"
+        n+=1
+    return path
+
+if __name__ == "__main__":
+    parser=argparse.ArgumentParser(description="Extract the lz4 log files from an image of the raw log partition")
+    parser.add_argument('image',help="image of the sdcard (or of the partition with --offset 0)")
+    parser.add_argument('-o','--outdir',default='.',help="directory to write the files to")
+    parser.add_argument('--offset',type=int,help="first sector of the partition (default: from the MBR)")
+    parser.add_argument('--sectors',type=int,help="size of the partition in sectors (default: from the MBR)")
+    parser.add_argument('-l','--list',action='store_true',help="only list the files")
+    args=parser.parse_args()
+
+    with open(args.image,'rb') as fid:
+        if args.offset is None or args.sectors is None:
+            start,nsectors=find_partition(fid)
+            start=start if args.offset is None else args.offset
+            nsectors=nsectors if args.sectors is None else args.sectors
+        else:
+            start,nsectors=args.offset,args.sectors
+        files=read_sectors(fid,start,nsectors)
+
+    for fileid in sorted(files):
+        result=assemble(files[fileid])
+        if result is None:
+            print(f"file {fileid}: start was overwritten, skipping",file=sys.stderr)
+            continue
+        name,data,closed=result
+        if args.list:
+            print(f"{fileid:10d} {len(data):10d} {'closed' if closed else 'open  '} {name}")
+            continue
+        if not closed:
+            try:
+                data=recover(data)
+            except (ValueError,struct.error) as err:
+                print(f"{name}: cannot recover ({err}), skipping",file=sys.stderr)
+                continue
+        path=unique(os.path.join(args.outdir,os.path.basename(name)))
+        with open(path,'wb') as fout:
+            fout.write(data)
+        print(f"{path}: {len(data)} bytes{'' if closed else ' (recovered)'}")
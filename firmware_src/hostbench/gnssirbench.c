@@ -0,0 +1,207 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Host test harness of the reflector height retrieval: simulates PVT frames of satellites which
+* rise and set above a flat reflector, runs them through the SNR arc builder (snrarc.c) and
+* the retrieval (gnssir.c), and reports the accuracy of the heights and the cost per arc
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+#include <nrf_modem_gnss.h>
+#include "snrarc.h"
+#include "gnssir.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#define MAXLIST 16
+#define NSATS 24
+/* GPS satellites repeat their ground track every sidereal day, making two orbits */
+#define ORBIT_PERIOD 43082.0
+#define DEG2RAD (M_PI/180.0)
+
+struct simconf {
+	double height; /* [m] */
+	double alpha; /* amplitude of the reflected signal relative to the direct one */
+	double noise; /* standard deviation of the C/N0 noise [dB] */
+	double hours;
+};
+
+struct simresult {
+	int narcs;
+	int nretrieved;
+	double sumerr;
+	double sumerr2;
+	double maxerr;
+	double seconds;
+	double cycles;
+	uint64_t npoints;
+};
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+static double randn(void){
+	/* Box-Muller */
+	double u1=(rand()+1.0)/(RAND_MAX+2.0);
+	double u2=(rand()+1.0)/(RAND_MAX+2.0);
+	return sqrt(-2.0*log(u1))*cos(2*M_PI*u2);
+}
+
+/* C/N0 [0.1 dB-Hz] of the direct signal plus its reflection */
+static uint16_t simulate_cn0(const struct simconf * conf, double elev){
+	double direct=pow(10.0,(30.0+20.0*sin(elev*DEG2RAD))/20.0);
+	double phase=4*M_PI*conf->height/GNSSIR_L1_WAVELENGTH*sin(elev*DEG2RAD);
+	double amp=direct*sqrt(1.0+conf->alpha*conf->alpha+2*conf->alpha*cos(phase));
+	double cn0=20.0*log10(amp)+conf->noise*randn();
+	return (uint16_t)lrint(MAX(cn0,0.0)*10.0);
+}
+
+struct simrun {
+	const struct simconf * conf;
+	struct simresult * res;
+};
+
+/* receives the completed arcs from the builder */
+static void retrieve_arc(const uint8_t * arc, size_t narc, void * ctx){
+	const struct simconf * conf=((struct simrun *)ctx)->conf;
+	struct simresult * res=((struct simrun *)ctx)->res;
+	struct gnssir_result rh;
+
+	res->narcs++;
+	double t0=now();
+#ifdef HAVE_RDTSC
+	uint64_t c0=__rdtsc();
+#endif
+	int stat=gnssir_retrieve(arc,narc,&rh);
+#ifdef HAVE_RDTSC
+	res->cycles+=__rdtsc()-c0;
+#endif
+	res->seconds+=now()-t0;
+	res->npoints+=(narc-sizeof(struct snrarc_header))/sizeof(struct snrarc_point);
+	if (stat != GNSSIR_SUCCESS){
+		return;
+	}
+	double err=rh.height*1e-3-conf->height;
+	res->nretrieved++;
+	res->sumerr+=err;
+	res->sumerr2+=err*err;
+	res->maxerr=MAX(res->maxerr,fabs(err));
+}
+
+/* simulate one frame per second of a constellation with evenly spread orbits */
+static void simulate(const struct simconf * conf, struct simresult * res){
+	static struct snrarc_builder builder;
+	static struct snrarc_epoch epoch;
+	struct nrf_modem_gnss_pvt_data_frame pvt;
+	struct simrun run={conf,res};
+	uint32_t utc0=1760000000;
+
+	memset(res,0,sizeof(*res));
+	snrarc_init(&builder,retrieve_arc,&run);
+	for (int t=0;t<conf->hours*3600;t++){
+		memset(&pvt,0,sizeof(pvt));
+		int n=0;
+		for (int s=0;s<NSATS && n < NRF_MODEM_GNSS_MAX_SATELLITES;s++){
+			double maxelev=30.0+60.0*(s%5)/4.0;
+			double elev=maxelev*sin(2*M_PI*(t/ORBIT_PERIOD+(double)s/NSATS));
+			if (elev < CONFIG_GNSS_MIN_ELEV){
+				continue;
+			}
+			struct nrf_modem_gnss_sv * sv=&pvt.sv[n++];
+			sv->sv=s+1;
+			sv->signal=1;
+			/* the modem reports whole degrees */
+			sv->elevation=(int16_t)floor(elev);
+			sv->azimuth=(int16_t)fmod(s*37.0+t/240.0,360.0);
+			sv->cn0=simulate_cn0(conf,elev);
+		}
+		/* as queued by the event handler and processed in the main loop */
+		snrarc_pack(&pvt,utc0+t,&epoch);
+		snrarc_update(&builder,&epoch);
+	}
+}
+
+static int parselist(char * arg, double * list){
+	int n=0;
+	for (char * tok=strtok(arg,",");tok != NULL && n < MAXLIST;tok=strtok(NULL,",")){
+		list[n++]=atof(tok);
+	}
+	return n;
+}
+
+static void usage(const char * prog){
+	fprintf(stderr,"Usage: %s [options]\n"
+		"Retrieves reflector heights from simulated SNR arcs\n"
+		"  -H LIST    reflector heights [m] (default 1,2.5,4,6)\n"
+		"  -a ALPHA   amplitude of the reflection relative to the direct signal (default 0.3)\n"
+		"  -n SIGMA   noise of the C/N0 [dB] (default 0.5)\n"
+		"  -t HOURS   simulated time (default 24)\n"
+		"  -s SEED    seed of the noise (default 1)\n",prog);
+}
+
+int main(int argc, char ** argv){
+	double heights[MAXLIST]={1.0,2.5,4.0,6.0};
+	int nheights=4;
+	struct simconf conf={.alpha=0.3,.noise=0.5,.hours=24.0};
+	int opt;
+
+	while ((opt=getopt(argc,argv,"H:a:n:t:s:h")) != -1){
+		switch (opt){
+			case 'H':
+				nheights=parselist(optarg,heights);
+				break;
+			case 'a':
+				conf.alpha=atof(optarg);
+				break;
+			case 'n':
+				conf.noise=atof(optarg);
+				break;
+			case 't':
+				conf.hours=atof(optarg);
+				break;
+			case 's':
+				srand(atoi(optarg));
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (nheights <= 0){
+		usage(argv[0]);
+		return 1;
+	}
+
+	gnssir_init();
+	int ngrid=(CONFIG_GNSSR_GNSSIR_MAX_RH-CONFIG_GNSSR_GNSSIR_MIN_RH)/CONFIG_GNSSR_GNSSIR_RH_STEP+1;
+	printf("# elevations %d-%d deg every %d s, heights %d-%d mm in steps of %d mm (%d), alpha %.2f, noise %.2f dB\n",
+			CONFIG_GNSS_MIN_ELEV,CONFIG_GNSSR_ARC_MAX_ELEV,CONFIG_GNSSR_ARC_INTERVAL,CONFIG_GNSSR_GNSSIR_MIN_RH,
+			CONFIG_GNSSR_GNSSIR_MAX_RH,CONFIG_GNSSR_GNSSIR_RH_STEP,ngrid,conf.alpha,conf.noise);
+	printf("%8s %6s %9s %9s %9s %9s %8s %8s %12s\n","height","arcs","retrieved","bias[cm]","rms[cm]","max[cm]",
+			"points","us/arc","cycles/arc");
+
+	for (int i=0;i<nheights;i++){
+		struct simresult res;
+		conf.height=heights[i];
+		simulate(&conf,&res);
+		int nret=MAX(res.nretrieved,1);
+		int narcs=MAX(res.narcs,1);
+		printf("%8.3f %6d %9d %9.2f %9.2f %9.2f %8.0f %8.0f %12.0f\n",conf.height,res.narcs,res.nretrieved,
+				100*res.sumerr/nret,100*sqrt(res.sumerr2/nret),100*res.maxerr,(double)res.npoints/narcs,
+				1e6*res.seconds/narcs,res.cycles/narcs);
+	}
+	return 0;
+}
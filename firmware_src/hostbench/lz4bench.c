@@ -0,0 +1,502 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Host benchmark of the lz4stream writer: replays recorded NMEA data line by line through
+* lz4write_n() for a range of stream settings and reports compression ratio, throughput,
+* memory usage and the amount of data written per sync
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/sys/byteorder.h>
+#include "lz4file.h"
+#include "lz4frame.h"
+
+#define MAXLIST 16
+#define MAXCORPORA 16
+#define BENCH_STACK_SIZE (1024*1024)
+#define STACK_PAINT 0xA5
+#define LZ4_FRAME_MAGIC 0x184D2204U
+
+/* all memory of the lz4 library is allocated from this arena (see lz4file.c) */
+extern struct k_heap lz4arena;
+
+struct corpus {
+	const char * name;
+	char * data;
+	size_t size;
+};
+
+struct benchconf {
+	size_t chunksize;
+	int blocksizeid;
+	bool independent;
+	int level;
+	int sync_policy;
+	uint32_t sync_arg;
+	size_t prealloc;
+	const lz4dict * dict;
+	const char * outfile;
+	const struct corpus * corpus;
+};
+
+struct benchresult {
+	int stat;
+	double seconds;
+	size_t nout;
+	uint64_t ncalls;
+	size_t heappeak;
+	size_t stackpeak;
+	size_t cap;
+	uint64_t nwrites;
+	uint64_t nsyncs;
+	size_t maxunsynced;
+	uint32_t nwaits;
+	uint32_t hash;
+	struct shim_fs_stats fs;
+};
+
+struct benchjob {
+	const struct benchconf * conf;
+	struct benchresult * res;
+};
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+static bool isrmc(const char * line, size_t len){
+	return len > 6 && line[0] == '$' && strncmp(line+3,"RMC",3) == 0;
+}
+
+/* write the corpus to a new lz4 file, one NMEA sentence per call (runs in a thread with a painted stack) */
+static void * replay(void * arg){
+	struct benchjob * job=arg;
+	const struct benchconf * conf=job->conf;
+	struct benchresult * res=job->res;
+	const struct corpus * corpus=conf->corpus;
+	static lz4streamfile lz4id;
+	static char chunkbuf[LZ4_CHUNKBUF_SIZE(CHUNKSIZE)];
+
+	init_lz4stream(&lz4id,chunkbuf,conf->chunksize,false);
+	lz4id.prefs.frameInfo.blockSizeID=conf->blocksizeid;
+	lz4setindependent(&lz4id,conf->independent);
+	lz4setlevel(&lz4id,conf->level);
+	lz4setsync(&lz4id,conf->sync_policy,conf->sync_arg);
+	lz4setdict(&lz4id,conf->dict);
+	lz4setprealloc(&lz4id,conf->prealloc);
+
+	int64_t uptime=0;
+	shim_uptime_set(uptime);
+	sys_heap_runtime_stats_reset_max(&lz4arena.heap);
+	memset(&shim_fs_stats,0,sizeof(shim_fs_stats));
+	res->ncalls=0;
+
+	double tstart=now();
+	res->stat=lz4open(conf->outfile,&lz4id);
+	if (res->stat != LZ4_SUCCESS){
+		return NULL;
+	}
+	const char * line=corpus->data;
+	const char * end=corpus->data+corpus->size;
+	while (line < end){
+		const char * eol=memchr(line,'\n',end-line);
+		size_t len=(eol != NULL) ? (size_t)(eol-line)+1 : (size_t)(end-line);
+		if (isrmc(line,len)){
+			/* one epoch per second */
+			uptime+=MSEC_PER_SEC;
+			shim_uptime_set(uptime);
+		}
+		res->stat=lz4write_n(&lz4id,line,len);
+		if (res->stat != LZ4_SUCCESS){
+			break;
+		}
+		res->ncalls++;
+		line+=len;
+	}
+	res->cap=lz4id.cap;
+	int closestat=lz4close(&lz4id);
+	res->seconds=now()-tstart;
+	if (res->stat == LZ4_SUCCESS){
+		res->stat=closestat;
+	}
+
+	struct sys_memory_stats arenastats;
+	sys_heap_runtime_stats_get(&lz4arena.heap,&arenastats);
+	res->heappeak=arenastats.max_allocated_bytes;
+	res->nout=lz4id.nbytes;
+	res->hash=lz4id.hash;
+	res->nwrites=shim_fs_stats.nwrites;
+	res->nsyncs=shim_fs_stats.nsyncs;
+	res->maxunsynced=lz4id.maxunsynced;
+	res->fs=shim_fs_stats;
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+	res->nwaits=lz4id.nwaits;
+#else
+	res->nwaits=0;
+#endif
+	return NULL;
+}
+
+static void * noop(void * arg){
+	return arg;
+}
+
+/* run a function in a thread with a painted stack and return the number of stack bytes it touched */
+static size_t run_measured(void * (*func)(void *), void * arg){
+	char * stack=aligned_alloc(4096,BENCH_STACK_SIZE);
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	memset(stack,STACK_PAINT,BENCH_STACK_SIZE);
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr,stack,BENCH_STACK_SIZE);
+	pthread_create(&thread,&attr,func,arg);
+	pthread_join(thread,NULL);
+	pthread_attr_destroy(&attr);
+
+	/* the stack grows downwards, so the untouched part is at the bottom */
+	size_t nfree=0;
+	while (nfree < BENCH_STACK_SIZE && (unsigned char)stack[nfree] == STACK_PAINT){
+		nfree++;
+	}
+	free(stack);
+	return BENCH_STACK_SIZE-nfree;
+}
+
+static char * readfile(const char * path, size_t * size){
+	FILE * fid=fopen(path,"rb");
+	if (fid == NULL){
+		return NULL;
+	}
+	fseek(fid,0,SEEK_END);
+	long len=ftell(fid);
+	fseek(fid,0,SEEK_SET);
+	char * buf=malloc(len > 0 ? len : 1);
+	if (buf != NULL && fread(buf,1,len,fid) != (size_t)len){
+		free(buf);
+		buf=NULL;
+	}
+	fclose(fid);
+	*size=len;
+	return buf;
+}
+
+/* decompress a recorded lz4 log (possibly written with a preset dictionary) */
+static char * lz4inflate(const char * src, size_t nsrc, const char * dict, size_t ndict, size_t * size){
+	LZ4F_dctx * dctx;
+	size_t cap=4*nsrc+4096;
+	size_t nout=0;
+	char * out=malloc(cap);
+
+	if (out == NULL || LZ4F_isError(LZ4F_createDecompressionContext(&dctx,LZ4F_VERSION))){
+		free(out);
+		return NULL;
+	}
+	while (nsrc > 0){
+		if (cap-nout < 65536){
+			cap*=2;
+			char * tmp=realloc(out,cap);
+			if (tmp == NULL){
+				break;
+			}
+			out=tmp;
+		}
+		size_t dstsize=cap-nout;
+		size_t srcsize=nsrc;
+		size_t ret=LZ4F_decompress_usingDict(dctx,out+nout,&dstsize,src,&srcsize,dict,ndict,NULL);
+		if (LZ4F_isError(ret)){
+			fprintf(stderr,"lz4 decompression error: %s\n",LZ4F_getErrorName(ret));
+			break;
+		}
+		if (srcsize == 0 && dstsize == 0){
+			/* truncated frame */
+			break;
+		}
+		nout+=dstsize;
+		src+=srcsize;
+		nsrc-=srcsize;
+	}
+	LZ4F_freeDecompressionContext(dctx);
+	*size=nout;
+	return out;
+}
+
+static int loadcorpus(struct corpus * corpus, const char * path, const char * dict, size_t ndict){
+	corpus->name=strrchr(path,'/') != NULL ? strrchr(path,'/')+1 : path;
+	corpus->data=readfile(path,&corpus->size);
+	if (corpus->data == NULL){
+		fprintf(stderr,"Cannot read corpus %s\n",path);
+		return -1;
+	}
+	if (corpus->size >= 4 && sys_get_le32((const uint8_t *)corpus->data) == LZ4_FRAME_MAGIC){
+		size_t size;
+		char * data=lz4inflate(corpus->data,corpus->size,dict,ndict,&size);
+		free(corpus->data);
+		corpus->data=data;
+		corpus->size=size;
+		if (data == NULL || size == 0){
+			fprintf(stderr,"Cannot decompress corpus %s\n",path);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* compare the written file with the corpus, and its hash with the one computed while writing */
+static bool verify(const char * path, const struct corpus * corpus, const char * dict, size_t ndict, uint32_t hash){
+	size_t nsrc;
+	size_t nout=0;
+	char * src=readfile(path,&nsrc);
+	char * out=(src != NULL) ? lz4inflate(src,nsrc,dict,ndict,&nout) : NULL;
+	bool same=(out != NULL && nout == corpus->size && memcmp(out,corpus->data,nout) == 0 && XXH32(src,nsrc,0) == hash);
+	free(src);
+	free(out);
+	return same;
+}
+
+static int parselist(const char * arg, int * list){
+	int n=0;
+	char * end;
+	while (*arg != '\0' && n < MAXLIST){
+		list[n++]=strtol(arg,&end,10);
+		if (end == arg){
+			return -1;
+		}
+		arg=(*end == ',') ? end+1 : end;
+	}
+	return n;
+}
+
+static int parsesync(const char * arg, int * policy, uint32_t * syncarg){
+	const char * colon=strchr(arg,':');
+	*syncarg=(colon != NULL) ? strtoul(colon+1,NULL,10) : 0;
+	if (strcmp(arg,"always") == 0){
+		*policy=LZ4_SYNC_ALWAYS;
+	}else if (strcmp(arg,"close") == 0){
+		*policy=LZ4_SYNC_CLOSE;
+	}else if (strncmp(arg,"bytes:",6) == 0){
+		*policy=LZ4_SYNC_BYTES;
+	}else if (strncmp(arg,"interval:",9) == 0){
+		*policy=LZ4_SYNC_INTERVAL;
+	}else{
+		return -1;
+	}
+	return 0;
+}
+
+static void usage(const char * prog){
+	fprintf(stderr,"Usage: %s [options] CORPUS...\n"
+		"Replays NMEA corpora (plain text or lz4 logs) through the lz4stream writer\n"
+		"  -c LIST    chunk sizes (default 1024,2048,4096,8192,16384, at most %d)\n"
+		"  -b LIST    lz4 block size IDs 4..7 (default 4)\n"
+		"  -m MODES   linked, independent or both (default both)\n"
+		"  -l LIST    compression levels (default -1)\n"
+		"  -s POLICY  sync policy: always, close, bytes:N or interval:SECONDS (default always)\n"
+		"  -p BYTES   preallocate the output file (adds block checksums, trimmed on closing)\n"
+		"  -D FILE    preset dictionary (also used to decompress lz4 corpora)\n"
+		"  -r N       repeat every run N times and report the fastest (default 1)\n"
+		"  -o DIR     directory for the output files (default: current directory)\n"
+		"  -f         really fsync on every sync (default: only count syncs)\n"
+		"  -d         report the sdcard commands and time of a model of FatFs on an SPI sdcard\n"
+		"  -V         decompress and compare the output of every run\n",prog,CHUNKSIZE);
+}
+
+int main(int argc, char ** argv){
+	int chunksizes[MAXLIST]={1024,2048,4096,8192,16384};
+	int nchunksizes=5;
+	int blocksizeids[MAXLIST]={LZ4F_max64KB};
+	int nblocksizeids=1;
+	int levels[MAXLIST]={-1};
+	int nlevels=1;
+	bool modes[2]={false,true};
+	int nmodes=2;
+	int sync_policy=LZ4_SYNC_ALWAYS;
+	uint32_t sync_arg=0;
+	size_t prealloc=0;
+	const char * dictpath=NULL;
+	int nrepeat=1;
+	const char * outdir=".";
+	bool doverify=false;
+	bool dodisk=false;
+	int opt;
+
+	while ((opt=getopt(argc,argv,"c:b:m:l:s:p:D:r:o:fdVh")) != -1){
+		switch (opt){
+			case 'c':
+				nchunksizes=parselist(optarg,chunksizes);
+				break;
+			case 'b':
+				nblocksizeids=parselist(optarg,blocksizeids);
+				break;
+			case 'l':
+				nlevels=parselist(optarg,levels);
+				break;
+			case 'm':
+				if (strcmp(optarg,"linked") == 0){
+					nmodes=1;
+				}else if (strcmp(optarg,"independent") == 0){
+					modes[0]=true;
+					nmodes=1;
+				}else if (strcmp(optarg,"both") != 0){
+					nmodes=0;
+				}
+				break;
+			case 's':
+				if (parsesync(optarg,&sync_policy,&sync_arg) != 0){
+					nmodes=0;
+				}
+				break;
+			case 'p':
+				prealloc=strtoul(optarg,NULL,10);
+				break;
+			case 'D':
+				dictpath=optarg;
+				break;
+			case 'r':
+				nrepeat=MAX(atoi(optarg),1);
+				break;
+			case 'o':
+				outdir=optarg;
+				break;
+			case 'f':
+				shim_fs_set_fsync(true);
+				break;
+			case 'd':
+				dodisk=true;
+				break;
+			case 'V':
+				doverify=true;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind >= argc || nchunksizes <= 0 || nblocksizeids <= 0 || nlevels <= 0 || nmodes == 0){
+		usage(argv[0]);
+		return 1;
+	}
+	for (int i=0;i<nchunksizes;i++){
+		if (chunksizes[i] <= 0 || chunksizes[i] > CHUNKSIZE){
+			fprintf(stderr,"Chunk size %d is not within 1..%d\n",chunksizes[i],CHUNKSIZE);
+			return 1;
+		}
+	}
+	for (int i=0;i<nblocksizeids;i++){
+		if (blocksizeids[i] < LZ4F_max64KB || blocksizeids[i] > LZ4F_max4MB){
+			fprintf(stderr,"Block size ID %d is not within 4..7\n",blocksizeids[i]);
+			return 1;
+		}
+	}
+
+	shim_fs_set_root(outdir);
+	char * dict=NULL;
+	size_t ndict=0;
+	static lz4dict cdict;
+	if (dictpath != NULL){
+		dict=readfile(dictpath,&ndict);
+		if (dict == NULL || lz4loaddict(dictpath,&cdict) != LZ4_SUCCESS){
+			fprintf(stderr,"Cannot load dictionary %s\n",dictpath);
+			return 1;
+		}
+	}
+
+	struct corpus corpora[MAXCORPORA];
+	int ncorpora=0;
+	for (int i=optind;i<argc && ncorpora < MAXCORPORA;i++){
+		if (loadcorpus(&corpora[ncorpora],argv[i],dict,ndict) != 0){
+			return 1;
+		}
+		ncorpora++;
+	}
+
+	/* stack used by an empty thread (thread control block and TLS are placed on the provided stack) */
+	size_t stackbase=run_measured(noop,NULL);
+
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+	printf("# lz4stream with writer thread (stack: producer only)\n");
+#else
+	printf("# lz4stream synchronous\n");
+#endif
+	if (dodisk){
+		printf("# sdcard model: %u byte clusters, SPI %.1f MHz in %u byte transfers (%u us each), %u us per command, "
+				"%u us read access, %u us per write\n",shim_sd_model.cluster_size,shim_sd_model.spi_hz/1e6,
+				shim_sd_model.xfer_size,shim_sd_model.xfer_us,shim_sd_model.cmd_us,shim_sd_model.read_us,shim_sd_model.write_us);
+		printf("%-16s %6s %4s %-5s %5s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n","corpus","chunk","bsid","block","level",
+				"writes","syncs","dwrites","sectors","dreads","fatw","dev_s","MB/s","us/write","maxwrite","maxsync");
+	}else{
+		printf("%-16s %6s %4s %-5s %5s %6s %8s %10s %8s %6s %6s %8s %8s %8s %10s %6s\n","corpus","chunk","bsid","block","level",
+				"ratio","MB/s","calls/s","heap","stack","bound","writes","syncs","B/sync","maxunsync","waits");
+	}
+
+	int nfailed=0;
+	for (int c=0;c<ncorpora;c++){
+		for (int l=0;l<nlevels;l++){
+			for (int m=0;m<nmodes;m++){
+				for (int b=0;b<nblocksizeids;b++){
+					for (int s=0;s<nchunksizes;s++){
+						char outfile[300];
+						char hostfile[600];
+						snprintf(outfile,sizeof(outfile),"/SD:/bench_%s.lz4",corpora[c].name);
+						snprintf(hostfile,sizeof(hostfile),"%s/bench_%s.lz4",outdir,corpora[c].name);
+						struct benchconf conf={chunksizes[s],blocksizeids[b],modes[m],levels[l],sync_policy,sync_arg,prealloc,
+							(dictpath != NULL) ? &cdict : NULL,outfile,&corpora[c]};
+						struct benchresult best={0};
+						for (int r=0;r<nrepeat;r++){
+							struct benchresult res={0};
+							struct benchjob job={&conf,&res};
+							fs_unlink(outfile);
+							res.stackpeak=run_measured(replay,&job)-stackbase;
+							if (r == 0 || res.seconds < best.seconds){
+								best=res;
+							}
+						}
+						if (best.stat != LZ4_SUCCESS){
+							printf("%-16s %6d %4d %-5s %5d failed (%d)\n",corpora[c].name,chunksizes[s],blocksizeids[b],
+									modes[m] ? "indep" : "link",levels[l],best.stat);
+							nfailed++;
+							continue;
+						}
+						if (doverify && !verify(hostfile,&corpora[c],dict,ndict,best.hash)){
+							printf("%-16s %6d %4d %-5s %5d output differs from the corpus\n",corpora[c].name,chunksizes[s],
+									blocksizeids[b],modes[m] ? "indep" : "link",levels[l]);
+							nfailed++;
+							continue;
+						}
+						if (dodisk){
+							const struct shim_fs_stats * fs=&best.fs;
+							double seconds=fs->device_us*1e-6;
+							printf("%-16s %6d %4d %-5s %5d %8llu %8llu %8llu %8llu %8llu %8llu %8.2f %8.3f %8.0f %8.0f %8.0f\n",
+									corpora[c].name,chunksizes[s],blocksizeids[b],modes[m] ? "indep" : "link",levels[l],
+									(unsigned long long)fs->nwrites,(unsigned long long)fs->nsyncs,
+									(unsigned long long)fs->ndiskwrites,(unsigned long long)fs->nsectorswritten,
+									(unsigned long long)fs->ndiskreads,(unsigned long long)fs->nfatwrites,seconds,
+									seconds > 0 ? best.nout/seconds/1e6 : 0.0,fs->nwrites > 0 ? fs->write_us/fs->nwrites : 0.0,
+									fs->maxwrite_us,fs->maxsync_us);
+							continue;
+						}
+						double mbytes=corpora[c].size/1e6;
+						printf("%-16s %6d %4d %-5s %5d %6.2f %8.1f %10.0f %8zu %6zu %6zu %8llu %8llu %8.0f %10zu %6u\n",
+								corpora[c].name,chunksizes[s],blocksizeids[b],modes[m] ? "indep" : "link",levels[l],
+								(double)corpora[c].size/best.nout,mbytes/best.seconds,best.ncalls/best.seconds,
+								best.heappeak,best.stackpeak,best.cap,(unsigned long long)best.nwrites,
+								(unsigned long long)best.nsyncs,best.nsyncs > 0 ? (double)best.nout/best.nsyncs : 0.0,
+								best.maxunsynced,best.nwaits);
+					}
+				}
+			}
+		}
+	}
+	return (nfailed > 0) ? 2 : 0;
+}
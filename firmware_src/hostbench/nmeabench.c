@@ -0,0 +1,302 @@
+/*
+* Copyright (c) 2026 R. Rietbroek
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Host test harness of the NMEA parser (nmea_parse.c): checks it against a set of known sentences
+* and measures how many sentences per second it validates and decodes from recorded NMEA data
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "nmea_parse.h"
+
+struct line {
+	const char * str;
+	size_t len;
+};
+
+struct counts {
+	uint64_t valid;
+	uint64_t corrupt;
+	uint64_t types[4];
+	uint64_t undecoded;
+	uint64_t check; /* keeps the compiler from dropping the decoding */
+};
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+/* known sentences and the expected outcome */
+struct vector {
+	const char * str;
+	int stat; /* of nmea_parse */
+	int type;
+	int nfields;
+};
+
+static const struct vector vectors[]={
+	{"$GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*7F\r\n",NMEA_SUCCESS,NMEA_TYPE_GSV,20},
+	{"$GPGSV,3,3,10,31,05,120,,32,61,047,44*79",NMEA_SUCCESS,NMEA_TYPE_GSV,12},
+	{"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n",NMEA_SUCCESS,NMEA_TYPE_RMC,12},
+	{"$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n",NMEA_SUCCESS,NMEA_TYPE_GGA,15},
+	{"$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n",NMEA_SUCCESS,NMEA_TYPE_UNKNOWN,18},
+	{"$GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*7E\r\n",NMEA_ERR_CHECKSUM,0,0},
+	{"$GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,46*7F\r\n",NMEA_ERR_CHECKSUM,0,0},
+	{"$GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45\r\n",NMEA_ERR_FORMAT,0,0},
+	{"$GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,2",NMEA_ERR_FORMAT,0,0},
+	{"GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*7F\r\n",NMEA_ERR_FORMAT,0,0},
+	{"$GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*7G\r\n",NMEA_ERR_FORMAT,0,0},
+	{"$GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*7FX\r\n",NMEA_ERR_FORMAT,0,0},
+	{"$GPRMC,1235\n19,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n",NMEA_ERR_FORMAT,0,0},
+	{"$GPGSV,3,1,12,01,$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n",NMEA_ERR_FORMAT,0,0},
+	{"$*00",NMEA_ERR_FORMAT,0,0},
+	{"",NMEA_ERR_FORMAT,0,0},
+};
+
+#define CHECK(cond) do { if (!(cond)){ fprintf(stderr,"FAIL %s:%d: %s\n",__FILE__,__LINE__,#cond); nfail++; } } while (0)
+
+static int self_test(void){
+	struct nmea_sentence snt;
+	struct nmea_data data;
+	int nfail=0;
+
+	for (size_t i=0;i<sizeof(vectors)/sizeof(vectors[0]);i++){
+		const struct vector * v=&vectors[i];
+		int stat=nmea_parse(v->str,strlen(v->str),&snt);
+		if (stat != v->stat || (stat == NMEA_SUCCESS && (snt.type != v->type || snt.nfields != v->nfields))){
+			fprintf(stderr,"FAIL vector %zu: status %d type %d fields %d: %s\n",i,stat,
+					stat == NMEA_SUCCESS ? snt.type : 0,stat == NMEA_SUCCESS ? snt.nfields : 0,v->str);
+			nfail++;
+		}
+	}
+
+	/* field slices point into the (unmodified) sentence */
+	const char * gsv=vectors[0].str;
+	CHECK(nmea_parse(gsv,strlen(gsv),&snt) == NMEA_SUCCESS);
+	CHECK(snt.str == gsv);
+	CHECK(nmea_field_len(&snt,0) == 5 && memcmp(nmea_field_ptr(&snt,0),"GPGSV",5) == 0);
+	CHECK(nmea_field_len(&snt,19) == 2 && memcmp(nmea_field_ptr(&snt,19),"45",2) == 0);
+	CHECK(nmea_field_len(&snt,20) == 0);
+	CHECK(nmea_decode(&snt,&data) == NMEA_SUCCESS);
+	CHECK(data.gsv.nmsgs == 3 && data.gsv.msgnum == 1 && data.gsv.nsats == 12 && data.gsv.nentries == 4);
+	CHECK(data.gsv.sats[0].prn == 1 && data.gsv.sats[0].elevation == 40 && data.gsv.sats[0].azimuth == 83 &&
+			data.gsv.sats[0].snr == 46);
+	CHECK(data.gsv.sats[3].prn == 14 && data.gsv.sats[3].azimuth == 228 && data.gsv.sats[3].snr == 45);
+
+	/* untracked satellite */
+	CHECK(nmea_parse(vectors[1].str,strlen(vectors[1].str),&snt) == NMEA_SUCCESS);
+	CHECK(nmea_decode(&snt,&data) == NMEA_SUCCESS);
+	CHECK(data.gsv.nentries == 2 && data.gsv.sats[0].prn == 31 && data.gsv.sats[0].snr == -1 &&
+			data.gsv.sats[1].elevation == 61);
+
+	CHECK(nmea_parse(vectors[2].str,strlen(vectors[2].str),&snt) == NMEA_SUCCESS);
+	CHECK(nmea_decode(&snt,&data) == NMEA_SUCCESS);
+	CHECK(data.rmc.time == (12*3600+35*60+19)*1000 && data.rmc.valid);
+	CHECK(data.rmc.latitude == 481173000 && data.rmc.longitude == 115166667);
+	CHECK(data.rmc.day == 23 && data.rmc.month == 3 && data.rmc.year == 94);
+
+	CHECK(nmea_parse(vectors[3].str,strlen(vectors[3].str),&snt) == NMEA_SUCCESS);
+	CHECK(nmea_decode(&snt,&data) == NMEA_SUCCESS);
+	CHECK(data.gga.time == (12*3600+35*60+19)*1000 && data.gga.quality == 1 && data.gga.nsats == 8);
+	CHECK(data.gga.hdop == 90 && data.gga.altitude == 545400 && data.gga.latitude == 481173000);
+
+	/* southern and western hemisphere, fractional seconds */
+	const char * rmc="$GPRMC,235959.50,A,3356.1234,S,07038.5,W,0.0,0.0,311299,,,A*6A";
+	CHECK(nmea_parse(rmc,strlen(rmc),&snt) == NMEA_SUCCESS);
+	CHECK(nmea_decode(&snt,&data) == NMEA_SUCCESS);
+	CHECK(data.rmc.time == 86399500 && data.rmc.latitude == -339353900 && data.rmc.longitude == -706416667);
+
+	/* no fix yet */
+	const char * nofix="$GPRMC,,V,,,,,,,,,,N*53";
+	CHECK(nmea_parse(nofix,strlen(nofix),&snt) == NMEA_SUCCESS);
+	CHECK(nmea_decode(&snt,&data) == NMEA_SUCCESS);
+	CHECK(!data.rmc.valid && data.rmc.latitude == 0 && data.rmc.day == 0);
+
+	/* valid checksum, but malformed or missing fields */
+	const char * badfield="$GPGSV,3,1,12,0x,40,083,46*0D";
+	CHECK(nmea_parse(badfield,strlen(badfield),&snt) == NMEA_SUCCESS);
+	CHECK(nmea_decode(&snt,&data) == NMEA_ERR_FIELDS);
+	const char * short_rmc="$GPRMC,123519,A*07";
+	CHECK(nmea_parse(short_rmc,strlen(short_rmc),&snt) == NMEA_SUCCESS);
+	CHECK(nmea_decode(&snt,&data) == NMEA_ERR_FIELDS);
+
+	if (nfail == 0){
+		printf("# self test passed\n");
+	}
+	return nfail;
+}
+
+static char * read_file(const char * path, size_t * size){
+	FILE * fid=fopen(path,"rb");
+	if (fid == NULL){
+		return NULL;
+	}
+	fseek(fid,0,SEEK_END);
+	long n=ftell(fid);
+	fseek(fid,0,SEEK_SET);
+	char * buf=malloc(n+1);
+	if (buf == NULL || fread(buf,1,n,fid) != (size_t)n){
+		fclose(fid);
+		free(buf);
+		return NULL;
+	}
+	fclose(fid);
+	buf[n]='\0';
+	*size=n;
+	return buf;
+}
+
+/* split the data into lines (including their line end), without copying */
+static struct line * split_lines(const char * buf, size_t size, size_t * nlines){
+	size_t n=0;
+	for (size_t i=0;i<size;i++){
+		n+=(buf[i] == '\n');
+	}
+	struct line * lines=malloc((n+1)*sizeof(*lines));
+	n=0;
+	for (size_t start=0;start<size;){
+		const char * end=memchr(buf+start,'\n',size-start);
+		size_t len=(end == NULL) ? size-start : (size_t)(end-(buf+start))+1;
+		lines[n].str=buf+start;
+		lines[n++].len=len;
+		start+=len;
+	}
+	*nlines=n;
+	return lines;
+}
+
+/* change one character in a fraction of the lines, returns the number of changed lines */
+static size_t corrupt_lines(char * buf, struct line * lines, size_t nlines, double rate){
+	size_t ncorrupt=0;
+	for (size_t i=0;i<nlines;i++){
+		if (lines[i].len < 2 || rand() >= rate*RAND_MAX){
+			continue;
+		}
+		/* anything but the line end */
+		size_t k=(size_t)(rand()%(lines[i].len-1));
+		char * c=buf+(lines[i].str-buf)+k;
+		*c^=1 << (rand()%7);
+		ncorrupt++;
+	}
+	return ncorrupt;
+}
+
+static void run_parse(const struct line * lines, size_t nlines, struct counts * cnt){
+	struct nmea_sentence snt;
+	for (size_t i=0;i<nlines;i++){
+		if (nmea_parse(lines[i].str,lines[i].len,&snt) == NMEA_SUCCESS){
+			cnt->valid++;
+			cnt->types[snt.type]++;
+			cnt->check+=snt.nfields;
+		}else{
+			cnt->corrupt++;
+		}
+	}
+}
+
+static void run_decode(const struct line * lines, size_t nlines, struct counts * cnt){
+	struct nmea_sentence snt;
+	struct nmea_data data;
+	for (size_t i=0;i<nlines;i++){
+		if (nmea_parse(lines[i].str,lines[i].len,&snt) != NMEA_SUCCESS){
+			cnt->corrupt++;
+			continue;
+		}
+		cnt->valid++;
+		cnt->types[snt.type]++;
+		if (nmea_decode(&snt,&data) != NMEA_SUCCESS){
+			cnt->undecoded++;
+			continue;
+		}
+		cnt->check+=(data.type == NMEA_TYPE_GSV) ? data.gsv.nentries : data.rmc.time;
+	}
+}
+
+static void usage(const char * prog){
+	fprintf(stderr,"Usage: %s [options] FILE...\n"
+		"Validates and decodes recorded NMEA sentences (plain text, one per line)\n"
+		"  -V         check the parser against known sentences first (exits when that fails)\n"
+		"  -c RATE    corrupt one character in this fraction of the lines (default 0)\n"
+		"  -r N       repeat each run N times (default 5)\n"
+		"  -s SEED    seed of the corruption (default 1)\n",prog);
+}
+
+int main(int argc, char ** argv){
+	double rate=0.0;
+	int repeat=5;
+	int opt;
+
+	while ((opt=getopt(argc,argv,"Vc:r:s:h")) != -1){
+		switch (opt){
+			case 'V':
+				if (self_test() != 0){
+					return 1;
+				}
+				break;
+			case 'c':
+				rate=atof(optarg);
+				break;
+			case 'r':
+				repeat=atoi(optarg);
+				break;
+			case 's':
+				srand(atoi(optarg));
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (repeat < 1){
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%-24s %8s %8s %8s %8s %8s %8s %8s %12s %12s %8s\n","file","lines","injected","corrupt","GSV","RMC",
+			"GGA","other","parse[1/s]","decode[1/s]","MB/s");
+	for (int f=optind;f<argc;f++){
+		size_t size;
+		size_t nlines;
+		char * buf=read_file(argv[f],&size);
+		if (buf == NULL){
+			fprintf(stderr,"cannot read %s\n",argv[f]);
+			return 1;
+		}
+		struct line * lines=split_lines(buf,size,&nlines);
+		size_t ninjected=(rate > 0.0) ? corrupt_lines(buf,lines,nlines,rate) : 0;
+
+		/* keep the fastest of the repeated runs */
+		struct counts cnt;
+		double tparse=1e30;
+		double tdecode=1e30;
+		for (int r=0;r<repeat;r++){
+			memset(&cnt,0,sizeof(cnt));
+			double t0=now();
+			run_parse(lines,nlines,&cnt);
+			double t1=now();
+			tparse=(t1-t0 < tparse) ? t1-t0 : tparse;
+			memset(&cnt,0,sizeof(cnt));
+			t0=now();
+			run_decode(lines,nlines,&cnt);
+			t1=now();
+			tdecode=(t1-t0 < tdecode) ? t1-t0 : tdecode;
+		}
+		printf("%-24s %8zu %8zu %8lu %8lu %8lu %8lu %8lu %12.0f %12.0f %8.1f\n",argv[f],nlines,ninjected,
+				(unsigned long)cnt.corrupt,(unsigned long)cnt.types[NMEA_TYPE_GSV],
+				(unsigned long)cnt.types[NMEA_TYPE_RMC],(unsigned long)cnt.types[NMEA_TYPE_GGA],
+				(unsigned long)cnt.types[NMEA_TYPE_UNKNOWN],nlines/tparse,nlines/tdecode,size/tparse*1e-6);
+		if (cnt.undecoded > 0){
+			printf("# %lu valid sentences of a supported type could not be decoded\n",(unsigned long)cnt.undecoded);
+		}
+		free(lines);
+		free(buf);
+	}
+	return 0;
+}
@@ -0,0 +1,310 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Host implementation of the file system shim (see zephyr/fs/fs.h)
+*/
+
+#include <zephyr/fs/fs.h>
+#include <zephyr/sys/util.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define SD_MOUNTPOINT "/SD:"
+#define HOSTPATHLEN 512
+
+struct shim_fs_stats shim_fs_stats;
+
+#define SECTOR_SIZE 512
+
+/* 32 KiB clusters (cards of 32 GB and up), the 8 MHz SPI clock and 64 byte RAM buffer of the logger;
+ * the command and card timings are typical values, real cards vary a lot */
+struct shim_sd_model shim_sd_model={
+	.cluster_size=32768,
+	.spi_hz=8000000,
+	.xfer_size=64,
+	.xfer_us=10,
+	.cmd_us=50,
+	.read_us=300,
+	.write_us=800,
+};
+
+static const char * fsroot=".";
+static bool dofsync=false;
+
+void shim_fs_set_root(const char * dir){
+	fsroot=dir;
+}
+
+void shim_fs_set_fsync(bool enable){
+	dofsync=enable;
+}
+
+/* translate a path on the device to a path on the host */
+static const char * hostpath(const char * path, char * out){
+	size_t nmount=strlen(SD_MOUNTPOINT);
+	if (strncmp(path,SD_MOUNTPOINT,nmount) == 0){
+		snprintf(out,HOSTPATHLEN,"%s%s",fsroot,path+nmount);
+	}else{
+		snprintf(out,HOSTPATHLEN,"%s",path);
+	}
+	return out;
+}
+
+/* time to transfer a number of sectors over SPI */
+static double sd_transfer_us(uint64_t nsectors){
+	uint64_t nbytes=nsectors*SECTOR_SIZE;
+	uint64_t nxfers=(nbytes+shim_sd_model.xfer_size-1)/shim_sd_model.xfer_size;
+	return nbytes*8e6/shim_sd_model.spi_hz+nxfers*shim_sd_model.xfer_us;
+}
+
+static double sd_read(void){
+	shim_fs_stats.ndiskreads++;
+	return shim_sd_model.cmd_us+shim_sd_model.read_us+sd_transfer_us(1);
+}
+
+static double sd_write(uint64_t nsectors){
+	shim_fs_stats.ndiskwrites++;
+	shim_fs_stats.nsectorswritten+=nsectors;
+	return shim_sd_model.cmd_us+shim_sd_model.write_us+sd_transfer_us(nsectors);
+}
+
+static void model_allocate(struct fs_file_t * zfp, off_t end){
+	if (end <= zfp->allocated){
+		return;
+	}
+	off_t cluster=shim_sd_model.cluster_size;
+	zfp->allocated=(end+cluster-1)/cluster*cluster;
+	zfp->fatdirty=true;
+}
+
+/* the sdcard commands of an f_write() of size bytes at pos */
+static double model_write(struct fs_file_t * zfp, off_t pos, size_t size){
+	double us=0;
+	zfp->modified=true;
+	while (size > 0){
+		off_t sector=pos/SECTOR_SIZE;
+		size_t offset=pos%SECTOR_SIZE;
+		if (offset == 0 && size >= SECTOR_SIZE){
+			/* whole sectors are written directly (the sector buffer is replaced when it is one of them) */
+			size_t nsectors=size/SECTOR_SIZE;
+			if (zfp->bufsector >= sector && zfp->bufsector < sector+(off_t)nsectors){
+				zfp->bufdirty=false;
+			}
+			model_allocate(zfp,pos+nsectors*SECTOR_SIZE);
+			us+=sd_write(nsectors);
+			pos+=nsectors*SECTOR_SIZE;
+			size-=nsectors*SECTOR_SIZE;
+		}else{
+			if (zfp->bufsector != sector){
+				if (zfp->bufdirty){
+					us+=sd_write(1);
+					zfp->bufdirty=false;
+				}
+				if (pos < zfp->size){
+					us+=sd_read();
+				}
+				zfp->bufsector=sector;
+			}
+			size_t ncopy=MIN(size,SECTOR_SIZE-offset);
+			model_allocate(zfp,pos+ncopy);
+			zfp->bufdirty=true;
+			pos+=ncopy;
+			size-=ncopy;
+		}
+		if (pos > zfp->size){
+			zfp->size=pos;
+		}
+	}
+	return us;
+}
+
+/* the sdcard commands of an f_sync(): the sector buffer, the FAT when clusters were allocated and the
+ * directory entry */
+static double model_sync(struct fs_file_t * zfp){
+	double us=0;
+	if (!zfp->modified){
+		return 0;
+	}
+	zfp->modified=false;
+	if (zfp->bufdirty){
+		us+=sd_write(1);
+		zfp->bufdirty=false;
+	}
+	if (zfp->fatdirty){
+		shim_fs_stats.nfatwrites+=2;
+		us+=2*sd_write(1);
+		zfp->fatdirty=false;
+	}
+	us+=sd_read()+sd_write(1);
+	return us;
+}
+
+void fs_file_t_init(struct fs_file_t * zfp){
+	zfp->filep=NULL;
+	zfp->size=0;
+	zfp->allocated=0;
+	zfp->bufsector=-1;
+	zfp->bufdirty=false;
+	zfp->fatdirty=false;
+	zfp->modified=false;
+}
+
+void fs_dir_t_init(struct fs_dir_t * zdp){
+	zdp->dirp=NULL;
+}
+
+int fs_open(struct fs_file_t * zfp, const char * file_name, int flags){
+	char path[HOSTPATHLEN];
+	const char * mode="rb";
+
+	hostpath(file_name,path);
+	if (flags & FS_O_WRITE){
+		if (access(path,F_OK) == 0){
+			mode="r+b";
+		}else if (flags & FS_O_CREATE){
+			mode="w+b";
+		}else{
+			return -ENOENT;
+		}
+	}
+	fs_file_t_init(zfp);
+	zfp->filep=fopen(path,mode);
+	if (zfp->filep == NULL){
+		return -errno;
+	}
+	struct stat st;
+	if (fstat(fileno(zfp->filep),&st) == 0){
+		zfp->size=st.st_size;
+		model_allocate(zfp,zfp->size);
+		zfp->fatdirty=false;
+	}
+	if (flags & FS_O_APPEND){
+		fseeko(zfp->filep,0,SEEK_END);
+	}
+	return 0;
+}
+
+int fs_close(struct fs_file_t * zfp){
+	shim_fs_stats.device_us+=model_sync(zfp);
+	int ret=fclose(zfp->filep);
+	zfp->filep=NULL;
+	return (ret == 0) ? 0 : -EIO;
+}
+
+ssize_t fs_write(struct fs_file_t * zfp, const void * ptr, size_t size){
+	shim_fs_stats.nwrites++;
+	shim_fs_stats.nbytes+=size;
+	double us=model_write(zfp,ftello(zfp->filep),size);
+	shim_fs_stats.device_us+=us;
+	shim_fs_stats.write_us+=us;
+	shim_fs_stats.maxwrite_us=MAX(shim_fs_stats.maxwrite_us,us);
+	size_t written=fwrite(ptr,1,size,zfp->filep);
+	return (written == size) ? (ssize_t)written : -EIO;
+}
+
+ssize_t fs_read(struct fs_file_t * zfp, void * ptr, size_t size){
+	size_t nread=fread(ptr,1,size,zfp->filep);
+	return ferror(zfp->filep) ? -EIO : (ssize_t)nread;
+}
+
+int fs_sync(struct fs_file_t * zfp){
+	shim_fs_stats.nsyncs++;
+	double us=model_sync(zfp);
+	shim_fs_stats.device_us+=us;
+	shim_fs_stats.maxsync_us=MAX(shim_fs_stats.maxsync_us,us);
+	if (fflush(zfp->filep) != 0){
+		return -EIO;
+	}
+	if (dofsync && fsync(fileno(zfp->filep)) != 0){
+		return -EIO;
+	}
+	return 0;
+}
+
+int fs_seek(struct fs_file_t * zfp, off_t offset, int whence){
+	static const int posixwhence[]={SEEK_SET,SEEK_CUR,SEEK_END};
+	return (fseeko(zfp->filep,offset,posixwhence[whence]) == 0) ? 0 : -EINVAL;
+}
+
+off_t fs_tell(struct fs_file_t * zfp){
+	return ftello(zfp->filep);
+}
+
+int fs_truncate(struct fs_file_t * zfp, off_t length){
+	if (length > zfp->allocated){
+		model_allocate(zfp,length);
+	}else if (length < zfp->size){
+		off_t cluster=shim_sd_model.cluster_size;
+		zfp->allocated=(length+cluster-1)/cluster*cluster;
+		zfp->fatdirty=true;
+	}
+	zfp->size=length;
+	zfp->modified=true;
+	fflush(zfp->filep);
+	return (ftruncate(fileno(zfp->filep),length) == 0) ? 0 : -errno;
+}
+
+int fs_rename(const char * from, const char * to){
+	char hostfrom[HOSTPATHLEN];
+	char hostto[HOSTPATHLEN];
+	return (rename(hostpath(from,hostfrom),hostpath(to,hostto)) == 0) ? 0 : -errno;
+}
+
+int fs_unlink(const char * path){
+	char host[HOSTPATHLEN];
+	return (unlink(hostpath(path,host)) == 0) ? 0 : -errno;
+}
+
+int fs_stat(const char * path, struct fs_dirent * entry){
+	char host[HOSTPATHLEN];
+	struct stat st;
+
+	if (stat(hostpath(path,host),&st) != 0){
+		return -ENOENT;
+	}
+	const char * name=strrchr(path,'/');
+	snprintf(entry->name,sizeof(entry->name),"%s",(name != NULL) ? name+1 : path);
+	entry->type=S_ISDIR(st.st_mode) ? FS_DIR_ENTRY_DIR : FS_DIR_ENTRY_FILE;
+	entry->size=st.st_size;
+	return 0;
+}
+
+int fs_mkdir(const char * path){
+	char host[HOSTPATHLEN];
+	return (mkdir(hostpath(path,host),0755) == 0) ? 0 : -errno;
+}
+
+int fs_opendir(struct fs_dir_t * zdp, const char * path){
+	char host[HOSTPATHLEN];
+	zdp->dirp=opendir(hostpath(path,host));
+	return (zdp->dirp != NULL) ? 0 : -ENOENT;
+}
+
+/* an empty name marks the end of the directory (as in zephyr) */
+int fs_readdir(struct fs_dir_t * zdp, struct fs_dirent * entry){
+	struct dirent * de;
+	do {
+		de=readdir(zdp->dirp);
+	} while (de != NULL && (strcmp(de->d_name,".") == 0 || strcmp(de->d_name,"..") == 0));
+
+	if (de == NULL){
+		entry->name[0]='\0';
+		return 0;
+	}
+	snprintf(entry->name,sizeof(entry->name),"%s",de->d_name);
+	entry->type=(de->d_type == DT_DIR) ? FS_DIR_ENTRY_DIR : FS_DIR_ENTRY_FILE;
+	entry->size=0;
+	return 0;
+}
+
+int fs_closedir(struct fs_dir_t * zdp){
+	int ret=closedir(zdp->dirp);
+	zdp->dirp=NULL;
+	return (ret == 0) ? 0 : -EIO;
+}
@@ -0,0 +1,149 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Host implementation of the kernel shim (see zephyr/kernel.h)
+*/
+
+#include <zephyr/kernel.h>
+
+static int64_t uptime_ms=0;
+
+int64_t k_uptime_get(void){
+	return __atomic_load_n(&uptime_ms,__ATOMIC_SEQ_CST);
+}
+
+void shim_uptime_set(int64_t ms){
+	__atomic_store_n(&uptime_ms,ms,__ATOMIC_SEQ_CST);
+}
+
+int k_sem_init(struct k_sem * sem, unsigned int initial, unsigned int limit){
+	pthread_mutex_init(&sem->lock,NULL);
+	pthread_cond_init(&sem->cond,NULL);
+	sem->count=initial;
+	sem->limit=limit;
+	return 0;
+}
+
+int k_sem_take(struct k_sem * sem, k_timeout_t timeout){
+	pthread_mutex_lock(&sem->lock);
+	while (sem->count == 0){
+		if (timeout.ms == 0){
+			pthread_mutex_unlock(&sem->lock);
+			return -EBUSY;
+		}
+		pthread_cond_wait(&sem->cond,&sem->lock);
+	}
+	sem->count--;
+	pthread_mutex_unlock(&sem->lock);
+	return 0;
+}
+
+void k_sem_give(struct k_sem * sem){
+	pthread_mutex_lock(&sem->lock);
+	if (sem->count < sem->limit){
+		sem->count++;
+	}
+	pthread_cond_signal(&sem->cond);
+	pthread_mutex_unlock(&sem->lock);
+}
+
+int k_mutex_lock(struct k_mutex * mutex, k_timeout_t timeout){
+	ARG_UNUSED(timeout);
+	return pthread_mutex_lock(&mutex->lock);
+}
+
+int k_mutex_unlock(struct k_mutex * mutex){
+	return pthread_mutex_unlock(&mutex->lock);
+}
+
+int k_msgq_put(struct k_msgq * msgq, const void * data, k_timeout_t timeout){
+	pthread_mutex_lock(&msgq->lock);
+	while (msgq->used_msgs == msgq->max_msgs){
+		if (timeout.ms == 0){
+			pthread_mutex_unlock(&msgq->lock);
+			return -ENOMSG;
+		}
+		pthread_cond_wait(&msgq->cond,&msgq->lock);
+	}
+	memcpy(msgq->buffer+msgq->write*msgq->msg_size,data,msgq->msg_size);
+	msgq->write=(msgq->write+1)%msgq->max_msgs;
+	msgq->used_msgs++;
+	pthread_cond_broadcast(&msgq->cond);
+	pthread_mutex_unlock(&msgq->lock);
+	return 0;
+}
+
+int k_msgq_get(struct k_msgq * msgq, void * data, k_timeout_t timeout){
+	pthread_mutex_lock(&msgq->lock);
+	while (msgq->used_msgs == 0){
+		if (timeout.ms == 0){
+			pthread_mutex_unlock(&msgq->lock);
+			return -ENOMSG;
+		}
+		pthread_cond_wait(&msgq->cond,&msgq->lock);
+	}
+	memcpy(data,msgq->buffer+msgq->read*msgq->msg_size,msgq->msg_size);
+	msgq->read=(msgq->read+1)%msgq->max_msgs;
+	msgq->used_msgs--;
+	pthread_cond_broadcast(&msgq->cond);
+	pthread_mutex_unlock(&msgq->lock);
+	return 0;
+}
+
+uint32_t k_msgq_num_used_get(struct k_msgq * msgq){
+	pthread_mutex_lock(&msgq->lock);
+	uint32_t used=msgq->used_msgs;
+	pthread_mutex_unlock(&msgq->lock);
+	return used;
+}
+
+/* allocations carry their size in front, so the statistics can be updated when freeing */
+void * k_heap_alloc(struct k_heap * heap, size_t bytes, k_timeout_t timeout){
+	ARG_UNUSED(timeout);
+	struct sys_heap * h=&heap->heap;
+	void * mem=NULL;
+
+	pthread_mutex_lock(&h->lock);
+	if (h->allocated+bytes <= h->size){
+		size_t * block=malloc(sizeof(size_t)+bytes);
+		if (block != NULL){
+			block[0]=bytes;
+			mem=&block[1];
+			h->allocated+=bytes;
+			h->max_allocated=MAX(h->max_allocated,h->allocated);
+		}
+	}
+	pthread_mutex_unlock(&h->lock);
+	return mem;
+}
+
+void k_heap_free(struct k_heap * heap, void * mem){
+	if (mem == NULL){
+		return;
+	}
+	struct sys_heap * h=&heap->heap;
+	size_t * block=(size_t *)mem-1;
+
+	pthread_mutex_lock(&h->lock);
+	h->allocated-=block[0];
+	pthread_mutex_unlock(&h->lock);
+	free(block);
+}
+
+int sys_heap_runtime_stats_get(struct sys_heap * heap, struct sys_memory_stats * stats){
+	pthread_mutex_lock(&heap->lock);
+	stats->allocated_bytes=heap->allocated;
+	stats->free_bytes=heap->size-heap->allocated;
+	stats->max_allocated_bytes=heap->max_allocated;
+	pthread_mutex_unlock(&heap->lock);
+	return 0;
+}
+
+int sys_heap_runtime_stats_reset_max(struct sys_heap * heap){
+	pthread_mutex_lock(&heap->lock);
+	heap->max_allocated=heap->allocated;
+	pthread_mutex_unlock(&heap->lock);
+	return 0;
+}
@@ -0,0 +1,56 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* The GNSS data types of the nRF modem library (only the fields used by the application),
+* so the processing of PVT frames can be run on a development machine
+*/
+
+#ifndef SHIM_NRF_MODEM_GNSS_H
+#define SHIM_NRF_MODEM_GNSS_H
+
+#include <stdint.h>
+
+#define NRF_MODEM_GNSS_MAX_SATELLITES 12
+#define NRF_MODEM_GNSS_NMEA_MAX_LEN 83
+
+#define NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID 0x01
+
+#define NRF_MODEM_GNSS_SV_FLAG_USED_IN_FIX 0x02
+#define NRF_MODEM_GNSS_SV_FLAG_UNHEALTHY 0x08
+
+struct nrf_modem_gnss_datetime {
+	uint16_t year;
+	uint8_t month;
+	uint8_t day;
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t seconds;
+	uint16_t ms;
+};
+
+struct nrf_modem_gnss_sv {
+	uint16_t sv;
+	uint8_t signal;
+	uint16_t cn0; /* 0.1 dB-Hz */
+	int16_t elevation; /* degrees */
+	int16_t azimuth; /* degrees */
+	uint8_t flags;
+};
+
+struct nrf_modem_gnss_pvt_data_frame {
+	double latitude;
+	double longitude;
+	float altitude;
+	float accuracy;
+	struct nrf_modem_gnss_datetime datetime;
+	uint8_t flags;
+	struct nrf_modem_gnss_sv sv[NRF_MODEM_GNSS_MAX_SATELLITES];
+};
+
+struct nrf_modem_gnss_nmea_data_frame {
+	char nmea_str[NRF_MODEM_GNSS_NMEA_MAX_LEN];
+};
+
+#endif /* SHIM_NRF_MODEM_GNSS_H */
@@ -0,0 +1,119 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Host implementation of the Zephyr file system API (subset), backed by POSIX files.
+* Paths starting with the sdcard mount point /SD: are mapped to a directory on the host
+*/
+
+#ifndef SHIM_FS_H
+#define SHIM_FS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define FS_O_READ 0x01
+#define FS_O_WRITE 0x02
+#define FS_O_RDWR (FS_O_READ|FS_O_WRITE)
+#define FS_O_CREATE 0x10
+#define FS_O_APPEND 0x20
+
+#define FS_SEEK_SET 0
+#define FS_SEEK_CUR 1
+#define FS_SEEK_END 2
+
+#define MAX_FILE_NAME 255
+
+struct fs_file_t {
+	FILE * filep;
+	/* state of the modelled FAT file (see shim_sd_model) */
+	off_t size;
+	off_t allocated; /* bytes in the clusters of the file */
+	off_t bufsector; /* sector in the sector buffer of the file (-1: none) */
+	bool bufdirty;
+	bool fatdirty; /* clusters were allocated or freed since the last sync */
+	bool modified; /* written since the last sync */
+};
+
+struct fs_dir_t {
+	void * dirp;
+};
+
+enum fs_dir_entry_type {
+	FS_DIR_ENTRY_FILE=0,
+	FS_DIR_ENTRY_DIR
+};
+
+struct fs_dirent {
+	enum fs_dir_entry_type type;
+	char name[MAX_FILE_NAME+1];
+	size_t size;
+};
+
+/*
+ * Rough model of FatFs on an sdcard over SPI, to compare write patterns: which sector reads and
+ * (multi-block) writes the file system would issue for the fs_write() and fs_sync() calls, and how
+ * long these would take. Writes of whole, aligned sectors go straight to the card, other data goes
+ * through the sector buffer of the file (which is read first when it holds data of the file). New
+ * clusters dirty the FAT, which is written (both copies) by the next sync, like the directory
+ * entry. Extending a file with fs_truncate() only allocates clusters, as f_expand does.
+ */
+struct shim_sd_model {
+	uint32_t cluster_size; /* bytes */
+	uint32_t spi_hz; /* SPI clock */
+	uint32_t xfer_size; /* bytes per SPI transfer (the RAM buffer of the SPI driver) */
+	uint32_t xfer_us; /* overhead per SPI transfer */
+	uint32_t cmd_us; /* overhead per read or write command */
+	uint32_t read_us; /* access time of a sector read */
+	uint32_t write_us; /* programming time per write command */
+};
+
+extern struct shim_sd_model shim_sd_model;
+
+/* counters of the file system operations, e.g. to determine the number of bytes per sync */
+struct shim_fs_stats {
+	uint64_t nwrites;
+	uint64_t nbytes;
+	uint64_t nsyncs;
+	/* sdcard commands of the modelled file system */
+	uint64_t ndiskwrites;
+	uint64_t nsectorswritten;
+	uint64_t ndiskreads;
+	uint64_t nfatwrites;
+	/* modelled time [us] spent in all calls, in the fs_write() calls, and in the slowest fs_write() and
+	 * fs_sync() call */
+	double device_us;
+	double write_us;
+	double maxwrite_us;
+	double maxsync_us;
+};
+
+extern struct shim_fs_stats shim_fs_stats;
+
+/* directory which holds the contents of /SD: (default: current directory) */
+void shim_fs_set_root(const char * dir);
+/* whether fs_sync() actually flushes to the disk of the host (default: only count) */
+void shim_fs_set_fsync(bool enable);
+
+void fs_file_t_init(struct fs_file_t * zfp);
+void fs_dir_t_init(struct fs_dir_t * zdp);
+int fs_open(struct fs_file_t * zfp, const char * file_name, int flags);
+int fs_close(struct fs_file_t * zfp);
+ssize_t fs_write(struct fs_file_t * zfp, const void * ptr, size_t size);
+ssize_t fs_read(struct fs_file_t * zfp, void * ptr, size_t size);
+int fs_sync(struct fs_file_t * zfp);
+int fs_seek(struct fs_file_t * zfp, off_t offset, int whence);
+off_t fs_tell(struct fs_file_t * zfp);
+int fs_truncate(struct fs_file_t * zfp, off_t length);
+int fs_rename(const char * from, const char * to);
+int fs_unlink(const char * path);
+int fs_stat(const char * path, struct fs_dirent * entry);
+int fs_mkdir(const char * path);
+int fs_opendir(struct fs_dir_t * zdp, const char * path);
+int fs_readdir(struct fs_dir_t * zdp, struct fs_dirent * entry);
+int fs_closedir(struct fs_dir_t * zdp);
+
+#endif /* SHIM_FS_H */
@@ -0,0 +1,9 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Everything needed from the file system interface is declared in fs.h
+*/
+
+#include <zephyr/fs/fs.h>
@@ -0,0 +1,134 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Minimal host (POSIX threads) implementation of the Zephyr kernel API used by the lz4stream
+* module, so that it can be built and benchmarked on a development machine
+*/
+
+#ifndef SHIM_KERNEL_H
+#define SHIM_KERNEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/util.h>
+
+#define MSEC_PER_SEC 1000
+
+typedef struct {
+	int64_t ms;
+} k_timeout_t;
+
+#define K_NO_WAIT ((k_timeout_t){0})
+#define K_FOREVER ((k_timeout_t){-1})
+#define K_MSEC(ms) ((k_timeout_t){(ms)})
+
+
+/*
+ * Uptime: a virtual clock which is advanced by the benchmark (e.g. by one second per NMEA epoch),
+ * so time based policies behave as if the data was recorded in real time
+ */
+int64_t k_uptime_get(void);
+void shim_uptime_set(int64_t ms);
+
+static inline void * k_malloc(size_t size){
+	return malloc(size);
+}
+
+static inline void k_free(void * ptr){
+	free(ptr);
+}
+
+/* semaphores */
+struct k_sem {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int count;
+	unsigned int limit;
+};
+
+#define K_SEM_MAX_LIMIT UINT32_MAX
+
+#define K_SEM_DEFINE(name, initial, lim) \
+	struct k_sem name={PTHREAD_MUTEX_INITIALIZER,PTHREAD_COND_INITIALIZER,(initial),(lim)}
+
+int k_sem_init(struct k_sem * sem, unsigned int initial, unsigned int limit);
+int k_sem_take(struct k_sem * sem, k_timeout_t timeout);
+void k_sem_give(struct k_sem * sem);
+
+/* mutexes */
+struct k_mutex {
+	pthread_mutex_t lock;
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name={PTHREAD_MUTEX_INITIALIZER}
+
+int k_mutex_lock(struct k_mutex * mutex, k_timeout_t timeout);
+int k_mutex_unlock(struct k_mutex * mutex);
+
+/* message queues */
+struct k_msgq {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t msg_size;
+	uint32_t max_msgs;
+	uint32_t used_msgs;
+	uint32_t read;
+	uint32_t write;
+	char * buffer;
+};
+
+#define K_MSGQ_DEFINE(name, size, max, align) \
+	static char _k_msgq_buf_##name[(size)*(max)]; \
+	struct k_msgq name={PTHREAD_MUTEX_INITIALIZER,PTHREAD_COND_INITIALIZER,(size),(max),0,0,0,_k_msgq_buf_##name}
+
+int k_msgq_put(struct k_msgq * msgq, const void * data, k_timeout_t timeout);
+int k_msgq_get(struct k_msgq * msgq, void * data, k_timeout_t timeout);
+uint32_t k_msgq_num_used_get(struct k_msgq * msgq);
+
+/* threads are started before main() (priority and options are ignored) */
+#define K_THREAD_DEFINE(name, stack_size, entry, p1, p2, p3, prio, options, delay) \
+	static void * _k_thread_##name(void * arg){ \
+		ARG_UNUSED(arg); \
+		entry(p1,p2,p3); \
+		return NULL; \
+	} \
+	__attribute__((constructor)) static void _k_thread_start_##name(void){ \
+		pthread_t thread; \
+		pthread_create(&thread,NULL,_k_thread_##name,NULL); \
+		pthread_detach(thread); \
+	}
+
+/* heaps: backed by malloc, but limited to their size and with runtime statistics */
+struct sys_heap {
+	size_t size;
+	size_t allocated;
+	size_t max_allocated;
+	pthread_mutex_t lock;
+};
+
+struct k_heap {
+	struct sys_heap heap;
+};
+
+struct sys_memory_stats {
+	size_t free_bytes;
+	size_t allocated_bytes;
+	size_t max_allocated_bytes;
+};
+
+#define K_HEAP_DEFINE(name, bytes) struct k_heap name={{(bytes),0,0,PTHREAD_MUTEX_INITIALIZER}}
+
+void * k_heap_alloc(struct k_heap * heap, size_t bytes, k_timeout_t timeout);
+void k_heap_free(struct k_heap * heap, void * mem);
+int sys_heap_runtime_stats_get(struct sys_heap * heap, struct sys_memory_stats * stats);
+int sys_heap_runtime_stats_reset_max(struct sys_heap * heap);
+
+#endif /* SHIM_KERNEL_H */
@@ -0,0 +1,24 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Logging to stderr on the host: errors and warnings are always printed, info and
+* debug messages only when the environment variable HOSTBENCH_VERBOSE is set
+*/
+
+#ifndef SHIM_LOG_H
+#define SHIM_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOG_MODULE_REGISTER(...)
+#define LOG_MODULE_DECLARE(...)
+
+#define LOG_ERR(fmt, ...) fprintf(stderr,"E: " fmt "\n",##__VA_ARGS__)
+#define LOG_WRN(fmt, ...) fprintf(stderr,"W: " fmt "\n",##__VA_ARGS__)
+#define LOG_INF(fmt, ...) do { if (getenv("HOSTBENCH_VERBOSE")) fprintf(stderr,"I: " fmt "\n",##__VA_ARGS__); } while (0)
+#define LOG_DBG(fmt, ...) do { if (getenv("HOSTBENCH_VERBOSE")) fprintf(stderr,"D: " fmt "\n",##__VA_ARGS__); } while (0)
+
+#endif /* SHIM_LOG_H */
@@ -0,0 +1,25 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Zephyr atomic variables, implemented with the builtins of gcc and clang
+*/
+
+#ifndef SHIM_ATOMIC_H
+#define SHIM_ATOMIC_H
+
+typedef long atomic_t;
+typedef long atomic_val_t;
+
+#define ATOMIC_INIT(val) (val)
+
+static inline atomic_val_t atomic_get(const atomic_t * target){
+	return __atomic_load_n(target,__ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_set(atomic_t * target, atomic_val_t value){
+	return __atomic_exchange_n(target,value,__ATOMIC_SEQ_CST);
+}
+
+#endif /* SHIM_ATOMIC_H */
@@ -0,0 +1,22 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Subset of the Zephyr utility macros
+*/
+
+#ifndef SHIM_UTIL_H
+#define SHIM_UTIL_H
+
+#define ARG_UNUSED(x) (void)(x)
+#define ARRAY_SIZE(array) (sizeof(array)/sizeof((array)[0]))
+#ifndef MIN
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a) > (b)) ? (a) : (b))
+#endif
+#define CLAMP(val,low,high) (((val) <= (low)) ? (low) : MIN(val,high))
+
+#endif /* SHIM_UTIL_H */
@@ -0,0 +1,16 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*
+* Host versions of the compiler attributes of the Zephyr toolchain header
+*/
+
+#ifndef SHIM_TOOLCHAIN_H
+#define SHIM_TOOLCHAIN_H
+
+#define BUILD_ASSERT(cond, msg) _Static_assert(cond, msg)
+#define __packed __attribute__((__packed__))
+#define __aligned(x) __attribute__((__aligned__(x)))
+
+#endif /* SHIM_TOOLCHAIN_H */
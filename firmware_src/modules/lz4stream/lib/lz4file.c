@@ -8,11 +8,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 #include <zephyr/logging/log.h>
 #include "lz4file.h"
+#define XXH_STATIC_LINKING_ONLY
+#include "xxhash.h"
+#include "lz4hc.h"
 #include <zephyr/fs/fs.h>
 #include <zephyr/fs/fs_interface.h>
+#include <zephyr/sys/byteorder.h>
+#ifdef CONFIG_FAT_FILESYSTEM_ELM
+#include <ff.h>
+#if defined(CONFIG_LZ4STREAM_FATFS_EXPAND) && !FF_USE_EXPAND
+#warning "CONFIG_LZ4STREAM_FATFS_EXPAND is set but FatFs is configured without FF_USE_EXPAND, lz4 files are not preallocated"
+#endif
+#endif
 /*#include <zephyr/kernel.h>*/
 
 
@@ -22,13 +33,38 @@ LOG_MODULE_REGISTER(LZ4STREAM,LOG_LEVEL_DBG);
 
 
 
-void init_lz4stream(lz4streamfile * lz4id, const bool reuseContext){
-	lz4id->ctx=NULL;
-	lz4id->fid=NULL;
-	lz4id->isOpen=false;
-	lz4id->reuseContext=reuseContext;
-	lz4id->nsrcdata=0;
-}
+/* operations which can be requested from the compression stage */
+#define LZ4_OP_UPDATE 0
+#define LZ4_OP_END 1
+#define LZ4_OP_MARK 2 /* end the current block and add an index entry */
+
+/* layout of the index sidecar: header followed by (utc time, file offset) entries */
+#define LZ4_INDEX_MAGIC "L4IX"
+#define LZ4_INDEX_VERSION 1
+
+struct lz4indexheader {
+	char magic[4];
+	uint8_t version;
+	uint8_t reserved[3];
+	uint32_t interval;
+} __packed;
+
+struct lz4indexentry {
+	uint32_t utc; /* unix time of the first data in the block */
+	uint32_t offset; /* file offset of the block */
+} __packed;
+
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+struct lz4job {
+	lz4streamfile * lz4id;
+	const char * src;
+	size_t nsrc;
+	int op;
+	uint32_t mark;
+};
+
+K_MSGQ_DEFINE(lz4job_queue, sizeof(struct lz4job), CONFIG_LZ4STREAM_WRITER_QUEUE_DEPTH, 4);
+#endif
 
 static const LZ4F_preferences_t kPrefs = {
     {LZ4F_max64KB, LZ4F_blockLinked, LZ4F_noContentChecksum, LZ4F_frame,
@@ -39,6 +75,239 @@ static const LZ4F_preferences_t kPrefs = {
     { 0, 0, 0 },  /* reserved, must be set to 0 */
 };
 
+#ifdef CONFIG_LZ4STREAM_STATIC_ARENA
+/* all memory of the lz4 library is served from this fixed size heap */
+K_HEAP_DEFINE(lz4arena, CONFIG_LZ4STREAM_ARENA_SIZE);
+
+/* memory functions used by the lz4 library (compiled with LZ4_USER_MEMORY_FUNCTIONS) */
+void * LZ4_malloc(size_t s){
+	void * ptr=k_heap_alloc(&lz4arena,s,K_NO_WAIT);
+	if (ptr == NULL){
+		LOG_ERR("lz4 arena exhausted (requested %d bytes)",(int)s);
+	}
+	return ptr;
+}
+
+void * LZ4_calloc(size_t n, size_t s){
+	if (s != 0 && n > SIZE_MAX/s){
+		return NULL;
+	}
+	void * ptr=LZ4_malloc(n*s);
+	if (ptr != NULL){
+		memset(ptr,0,n*s);
+	}
+	return ptr;
+}
+
+void LZ4_free(void * p){
+	if (p != NULL){
+		k_heap_free(&lz4arena,p);
+	}
+}
+
+#define lz4tmpalloc(s) LZ4_malloc(s)
+#define lz4tmpfree(p) LZ4_free(p)
+#else
+#define lz4tmpalloc(s) k_malloc(s)
+#define lz4tmpfree(p) k_free(p)
+#endif
+
+/* pool of compression contexts shared by all streams */
+static lz4context lz4pool[CONFIG_LZ4STREAM_CONTEXT_POOL_SIZE];
+K_MUTEX_DEFINE(lz4pool_lock);
+
+/* take a context from the pool, preferably the one this stream used before (its buffers
+ * were allocated for the same kind of frame, so reusing it does not grow the heap) */
+static int lz4acquire(lz4streamfile * lz4id){
+	lz4context * pctx=NULL;
+
+	k_mutex_lock(&lz4pool_lock,K_FOREVER);
+	if (lz4id->pctx != NULL && !lz4id->pctx->inUse){
+		pctx=lz4id->pctx;
+	}else{
+		for (int i=0;i<CONFIG_LZ4STREAM_CONTEXT_POOL_SIZE;i++){
+			if (!lz4pool[i].inUse){
+				pctx=&lz4pool[i];
+				break;
+			}
+		}
+	}
+	if (pctx != NULL){
+		pctx->inUse=true;
+	}
+	k_mutex_unlock(&lz4pool_lock);
+
+	if (pctx == NULL){
+		LOG_ERR("No free lz4 compression context (increase CONFIG_LZ4STREAM_CONTEXT_POOL_SIZE)");
+		return LZ4_ERR_COMPRESS;
+	}
+	lz4id->pctx=pctx;
+	return LZ4_SUCCESS;
+}
+
+/* return the context to the pool (the compression context itself is kept when it is reused) */
+static void lz4release(lz4streamfile * lz4id){
+	if (!lz4id->reuseContext){
+		LZ4F_freeCompressionContext(lz4id->pctx->ctx);
+		lz4id->pctx->ctx=NULL;
+	}
+	k_mutex_lock(&lz4pool_lock,K_FOREVER);
+	lz4id->pctx->inUse=false;
+	k_mutex_unlock(&lz4pool_lock);
+}
+
+/* chunkbuf needs to hold LZ4_CHUNKBUF_SIZE(chunksize) bytes, chunksize can be at most CHUNKSIZE */
+void init_lz4stream(lz4streamfile * lz4id, char * chunkbuf, size_t chunksize, const bool reuseContext){
+	if (chunksize > CHUNKSIZE){
+		LOG_ERR("lz4 chunk size %d exceeds the maximum of %d",(int)chunksize,CHUNKSIZE);
+		chunksize=CHUNKSIZE;
+	}
+	lz4id->pctx=NULL;
+	lz4id->isOpen=false;
+	lz4id->reuseContext=reuseContext;
+	lz4id->independent=false;
+	lz4id->chunksize=chunksize;
+	for (int i=0;i<LZ4_NSRCBUF;i++){
+		lz4id->srcbuf[i]=chunkbuf+i*chunksize;
+	}
+	lz4id->nsrcdata=0;
+	lz4id->fill=lz4id->srcbuf[0];
+	lz4id->sync_policy=LZ4_SYNC_ALWAYS;
+	lz4id->sync_arg=0;
+	lz4id->prealloc=0;
+	lz4id->prefs=kPrefs;
+	lz4id->dict=NULL;
+	lz4id->sink=NULL;
+	lz4id->idx_interval=0;
+	lz4id->idxOpen=false;
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+	k_sem_init(&lz4id->idle,1,1);
+	lz4id->werr=LZ4_SUCCESS;
+	lz4id->nswaps=0;
+	lz4id->nwaits=0;
+#endif
+}
+
+/* Write an index of block start times while writing the file (0 disables the index).
+ * Blocks are made independent and a new block is started every interval seconds, as
+ * provided by lz4mark() */
+void lz4setindex(lz4streamfile * lz4id, uint32_t interval){
+	lz4id->idx_interval=interval;
+}
+
+/* Load a preset dictionary from a file (its ID is the xxh32 hash of its content) */
+int lz4loaddict(const char * path, lz4dict * dict){
+	struct fs_file_t fid;
+	struct fs_dirent entry;
+
+	dict->cdict=NULL;
+	dict->id=0;
+	if (fs_stat(path,&entry) != 0){
+		return LZ4_ERR_IO;
+	}
+	if (entry.size == 0 || entry.size > CONFIG_LZ4STREAM_DICT_MAX_SIZE){
+		LOG_ERR("Size of dictionary %s (%d) is not within 1..%d bytes",path,(int)entry.size,CONFIG_LZ4STREAM_DICT_MAX_SIZE);
+		return LZ4_ERR_OVERSIZED;
+	}
+
+	char * buf=lz4tmpalloc(entry.size);
+	if (buf == NULL){
+		LOG_ERR("Cannot allocate dictionary buffer");
+		return LZ4_ERR_IO;
+	}
+
+	fs_file_t_init(&fid);
+	int stat=LZ4_ERR_IO;
+	if (fs_open(&fid,path,FS_O_READ) == 0){
+		if (fs_read(&fid,buf,entry.size) == (ssize_t)entry.size){
+			stat=LZ4_SUCCESS;
+		}
+		fs_close(&fid);
+	}
+
+	if (stat == LZ4_SUCCESS){
+		/* the dictionary content is copied into the digested dictionary */
+		dict->cdict=LZ4F_createCDict(buf,entry.size);
+		if (dict->cdict == NULL){
+			LOG_ERR("Cannot create lz4 dictionary");
+			stat=LZ4_ERR_COMPRESS;
+		}else{
+			dict->id=XXH32(buf,entry.size,0);
+			if (dict->id == 0){
+				/* 0 means no dictionary in the frame header */
+				dict->id=1;
+			}
+			LOG_INF("Loaded %d byte dictionary %s (ID %08x)",(int)entry.size,path,dict->id);
+		}
+	}
+	lz4tmpfree(buf);
+	return stat;
+}
+
+/* use independent blocks for the next files to be opened, also when no index is written.
+ * Slightly worse compression, but the context does not need to keep a 64 KiB copy of the history */
+void lz4setindependent(lz4streamfile * lz4id, bool independent){
+	lz4id->independent=independent;
+}
+
+/* Compression level for the next files to be opened. Levels below LZ4HC_CLEVEL_MIN use the fast
+ * compressor (negative levels trade ratio for speed), higher ones the HC compressor. Returns the
+ * level which will actually be used */
+int lz4setlevel(lz4streamfile * lz4id, int level){
+#ifdef CONFIG_LZ4STREAM_HC
+	/* the optimal parser of the highest levels needs a large extra work buffer */
+	int maxlevel=LZ4HC_CLEVEL_OPT_MIN-1;
+#else
+	int maxlevel=LZ4HC_CLEVEL_MIN-1;
+#endif
+	if (level > maxlevel){
+		LOG_WRN("lz4 compression level %d not supported, using %d",level,maxlevel);
+		level=maxlevel;
+	}
+	lz4id->prefs.compressionLevel=level;
+	return level;
+}
+
+/* use a preset dictionary for the next files to be opened (NULL disables the dictionary) */
+void lz4setdict(lz4streamfile * lz4id, const lz4dict * dict){
+	if (dict != NULL && dict->cdict == NULL){
+		dict=NULL;
+	}
+	lz4id->dict=dict;
+}
+
+/* set the policy to be used for syncing data to disk (takes effect for the next chunk written) */
+void lz4setsync(lz4streamfile * lz4id, int policy, uint32_t arg){
+	switch(policy){
+		case LZ4_SYNC_ALWAYS:
+		case LZ4_SYNC_BYTES:
+		case LZ4_SYNC_INTERVAL:
+		case LZ4_SYNC_CLOSE:
+			lz4id->sync_policy=policy;
+			lz4id->sync_arg=arg;
+			break;
+		default:
+			LOG_ERR("Unknown sync policy %d, syncing every chunk",policy);
+			lz4id->sync_policy=LZ4_SYNC_ALWAYS;
+			lz4id->sync_arg=0;
+	}
+}
+
+/* Allocate size bytes for the next files to be opened (0 disables this), ideally a bit more than
+ * they will finally take. Appending to the file then no longer extends its cluster chain, so
+ * writes and syncs only touch data sectors and the directory entry, rather than also the FAT.
+ * The file is trimmed to the written data when it is closed. Preallocated files get block
+ * checksums, so that lz4recover() can tell the written blocks from what was on the disk before */
+void lz4setprealloc(lz4streamfile * lz4id, size_t size){
+	lz4id->prealloc=size;
+}
+
+/* write the next files to be opened to a sink instead of the file system (NULL: file system).
+ * Indexes and preallocation are not supported by sinks */
+void lz4setsink(lz4streamfile * lz4id, const lz4sink * sink){
+	lz4id->sink=sink;
+}
+
 
 int handle_lz4error(size_t errcode){
 
@@ -52,11 +321,214 @@ int handle_lz4error(size_t errcode){
 
 }
 
+static int lz4fswrite(lz4streamfile * lz4id, const char * buf, size_t nbuf){
+	lz4id->nwrites++;
+	if (lz4id->sink != NULL){
+		return (lz4id->sink->write(lz4id->sink->ctx,buf,nbuf) == 0) ? LZ4_SUCCESS : LZ4_ERR_IO;
+	}
+	ssize_t written=fs_write(&lz4id->fid,buf,nbuf);
+	if (written < 0 || (size_t)written != nbuf){
+		LOG_ERR("Failed to write to lz4 output file (%d)",(int)written);
+		return LZ4_ERR_IO;
+	}
+	return LZ4_SUCCESS;
+}
+
+/* write compressed bytes to the output file (through the write buffer) and keep track of the statistics*/
+static int lz4output(lz4streamfile * lz4id, const char * buf, size_t nbuf){
+#if LZ4_WBUFSIZE > 0
+	char * wbuf=lz4id->pctx->wbuf;
+	const char * src=buf;
+	size_t n=(lz4id->sink == NULL) ? nbuf : 0;
+	if (lz4id->sink != NULL && lz4fswrite(lz4id,buf,nbuf) != LZ4_SUCCESS){
+		return LZ4_ERR_IO;
+	}
+	while (n > 0){
+		size_t ncopy=MIN(n,LZ4_WBUFSIZE-lz4id->nwbuf);
+		memcpy(wbuf+lz4id->nwbuf,src,ncopy);
+		lz4id->nwbuf+=ncopy;
+		src+=ncopy;
+		n-=ncopy;
+		if (lz4id->nwbuf == LZ4_WBUFSIZE){
+			if (lz4fswrite(lz4id,wbuf,LZ4_WBUFSIZE) != LZ4_SUCCESS){
+				return LZ4_ERR_IO;
+			}
+			lz4id->nwbuf=0;
+		}
+	}
+#else
+	if (lz4fswrite(lz4id,buf,nbuf) != LZ4_SUCCESS){
+		return LZ4_ERR_IO;
+	}
+#endif
+	XXH32_update(&lz4id->xxh,buf,nbuf);
+	lz4id->nbytes+=nbuf;
+	lz4id->nunsynced+=nbuf;
+	if (lz4id->nbytes > lz4id->nalloc){
+		/* beyond the preallocated part, the file grows as usual */
+		lz4id->nalloc=lz4id->nbytes;
+	}
+	return LZ4_SUCCESS;
+}
+
+/* Preallocate the just opened (empty) output file. On FatFs only with contiguous clusters, which it
+ * marks as used in a single pass over the FAT: extending the file instead would zero fill it over
+ * the sdcard interface. Other file systems extend the file. The file is written as usual when this
+ * fails */
+static void lz4preallocate(lz4streamfile * lz4id){
+	lz4id->nalloc=0;
+	lz4id->contiguous=false;
+	if (lz4id->prealloc == 0){
+		return;
+	}
+#ifdef CONFIG_FAT_FILESYSTEM_ELM
+#if FF_USE_EXPAND
+	if (f_expand((FIL *)lz4id->fid.filep,lz4id->prealloc,1) == FR_OK){
+		lz4id->nalloc=lz4id->prealloc;
+		lz4id->contiguous=true;
+		return;
+	}
+	LOG_WRN("No contiguous free space for %u bytes, not preallocating",(unsigned)lz4id->prealloc);
+#else
+	LOG_WRN("FatFs is built without f_expand, not preallocating");
+#endif
+#else
+	if (fs_truncate(&lz4id->fid,lz4id->prealloc) != 0 || fs_seek(&lz4id->fid,0,FS_SEEK_SET) != 0){
+		LOG_WRN("Cannot preallocate %u bytes",(unsigned)lz4id->prealloc);
+		fs_truncate(&lz4id->fid,0);
+		fs_seek(&lz4id->fid,0,FS_SEEK_SET);
+		return;
+	}
+	lz4id->nalloc=lz4id->prealloc;
+#endif
+}
+
+/* Write out the write buffer. Its incomplete last sector stays in the buffer and the file position
+ * is moved back to the start of that sector, so that it is written again, completed, with the next
+ * data and all writes stay sector aligned */
+static int lz4flush(lz4streamfile * lz4id){
+#if LZ4_WBUFSIZE > 0
+	char * wbuf=lz4id->pctx->wbuf;
+	if (lz4id->nwbuf == 0){
+		return LZ4_SUCCESS;
+	}
+	if (lz4fswrite(lz4id,wbuf,lz4id->nwbuf) != LZ4_SUCCESS){
+		return LZ4_ERR_IO;
+	}
+	size_t npartial=lz4id->nwbuf%LZ4_SECTOR_SIZE;
+	if (npartial > 0){
+		if (fs_seek(&lz4id->fid,-(off_t)npartial,FS_SEEK_CUR) != 0){
+			return LZ4_ERR_IO;
+		}
+		memmove(wbuf,wbuf+lz4id->nwbuf-npartial,npartial);
+	}
+	lz4id->nwbuf=npartial;
+#else
+	ARG_UNUSED(lz4id);
+#endif
+	return LZ4_SUCCESS;
+}
+
+/* sync the output file according to the chosen policy (or always when forced) */
+static int lz4sync(lz4streamfile * lz4id, bool force){
+	if (lz4id->nunsynced == 0){
+		return LZ4_SUCCESS;
+	}
+
+	if (!force){
+		switch(lz4id->sync_policy){
+			case LZ4_SYNC_BYTES:
+				if (lz4id->nunsynced < lz4id->sync_arg){
+					return LZ4_SUCCESS;
+				}
+				break;
+			case LZ4_SYNC_INTERVAL:
+				if (k_uptime_get() - lz4id->tsync < (int64_t)lz4id->sync_arg*MSEC_PER_SEC){
+					return LZ4_SUCCESS;
+				}
+				break;
+			case LZ4_SYNC_CLOSE:
+				return LZ4_SUCCESS;
+		}
+	}
+
+	if (lz4id->sink != NULL){
+		if (lz4id->sink->sync(lz4id->sink->ctx) != 0){
+			return LZ4_ERR_IO;
+		}
+	}else if (lz4flush(lz4id) != LZ4_SUCCESS || fs_sync(&lz4id->fid) != 0){
+		return LZ4_ERR_IO;
+	}
+	if (lz4id->idxOpen){
+		fs_sync(&lz4id->idxfid);
+	}
+	lz4id->nsyncs++;
+	if (lz4id->nunsynced > lz4id->maxunsynced){
+		lz4id->maxunsynced=lz4id->nunsynced;
+	}
+	lz4id->nunsynced=0;
+	lz4id->tsync=k_uptime_get();
+	return LZ4_SUCCESS;
+}
+
 static void tempname(char * dest,const char * src){
 	strcpy(dest,src);
 	strcat(dest,".tmp");
 }
 
+static void indexname(char * dest,const char * src){
+	strcpy(dest,src);
+	strcat(dest,".idx");
+}
+
+/* open the (temporary) index sidecar and write its header */
+static int lz4openindex(lz4streamfile * lz4id){
+	char pathidx[208];
+	char pathtmp[212];
+	indexname(pathidx,lz4id->filename);
+	tempname(pathtmp,pathidx);
+
+	fs_file_t_init(&lz4id->idxfid);
+	if (fs_open(&lz4id->idxfid,pathtmp,FS_O_WRITE|FS_O_CREATE) != 0){
+		LOG_ERR("Cannot open lz4 index file");
+		return LZ4_ERR_IO;
+	}
+
+	struct lz4indexheader header={LZ4_INDEX_MAGIC,LZ4_INDEX_VERSION,{0,0,0},sys_cpu_to_le32(lz4id->idx_interval)};
+	if (fs_write(&lz4id->idxfid,&header,sizeof(header)) != sizeof(header)){
+		fs_close(&lz4id->idxfid);
+		return LZ4_ERR_IO;
+	}
+	lz4id->idxOpen=true;
+	lz4id->lastslot=0;
+	lz4id->nmarks=0;
+	return LZ4_SUCCESS;
+}
+
+static int lz4closeindex(lz4streamfile * lz4id){
+	char pathidx[208];
+	char pathtmp[212];
+
+	if (!lz4id->idxOpen){
+		return LZ4_SUCCESS;
+	}
+	fs_close(&lz4id->idxfid);
+	lz4id->idxOpen=false;
+	indexname(pathidx,lz4id->filename);
+	tempname(pathtmp,pathidx);
+	fs_rename(pathtmp,pathidx);
+	return LZ4_SUCCESS;
+}
+
+/* close the output of a file which could not be started */
+static void lz4abort(lz4streamfile * lz4id){
+	if (lz4id->sink != NULL){
+		lz4id->sink->close(lz4id->sink->ctx);
+	}else{
+		fs_close(&lz4id->fid);
+	}
+}
+
 int lz4open(const char * path, lz4streamfile * lz4id){
 	
 
@@ -67,8 +539,7 @@ int lz4open(const char * path, lz4streamfile * lz4id){
 		LOG_ERR("Cannot allocate lz4 admin struct");
 		return LZ4_ERR_IO;
 	}
-	lz4id->fid=k_malloc(sizeof(struct fs_file_t));
-	fs_file_t_init(lz4id->fid);
+	fs_file_t_init(&lz4id->fid);
 	
 	strcpy(lz4id->filename,path);
 	
@@ -76,37 +547,88 @@ int lz4open(const char * path, lz4streamfile * lz4id){
 	char pathtmp[204];
 	tempname(pathtmp,lz4id->filename);
 
-	if ( fs_open(lz4id->fid,pathtmp,FS_O_WRITE|FS_O_CREATE)!=0){
-		k_free(lz4id);
-		lz4id=NULL;
-		LOG_ERR("Cannot open lz4 output file");
-		return LZ4_ERR_IO;
+	if (lz4id->sink != NULL){
+		if (lz4id->sink->open(lz4id->sink->ctx,lz4id->filename) != 0){
+			LOG_ERR("Cannot open lz4 output sink");
+			return LZ4_ERR_IO;
+		}
+		lz4id->nalloc=0;
+	}else{
+		if ( fs_open(&lz4id->fid,pathtmp,FS_O_WRITE|FS_O_CREATE)!=0){
+			LOG_ERR("Cannot open lz4 output file");
+			return LZ4_ERR_IO;
+		}
+		lz4preallocate(lz4id);
 	}
 	
 
-	lz4id->cap = LZ4F_compressBound(CHUNKSIZE, &kPrefs);   /* large enough for any input <= IN_CHUNK_SIZE */
-	LOG_DBG("Buffer size needed %d reserved %d\n",lz4id->cap,BUFFERSIZE);
+	/* blocks need to be decodable on their own when they can be looked up from an index */
+	lz4id->prefs.frameInfo.blockMode=(lz4id->idx_interval > 0 || lz4id->independent) ? LZ4F_blockIndependent : LZ4F_blockLinked;
+	const LZ4F_CDict * cdict=(lz4id->dict != NULL) ? lz4id->dict->cdict : NULL;
+#if defined(LZ4F_CDICT_FASTONLY) && LZ4F_CDICT_FASTONLY
+	/* dictionaries are only digested for the fast compressor */
+	if (cdict != NULL && lz4id->prefs.compressionLevel >= LZ4HC_CLEVEL_MIN){
+		LOG_WRN("Dictionary %08x is not used with HC level %d",lz4id->dict->id,lz4id->prefs.compressionLevel);
+		cdict=NULL;
+	}
+#endif
+	lz4id->prefs.frameInfo.dictID=(cdict != NULL) ? lz4id->dict->id : 0;
+	lz4id->prefs.frameInfo.blockChecksumFlag=(lz4id->nalloc > 0) ? LZ4F_blockChecksumEnabled : LZ4F_noBlockChecksum;
+
+	lz4id->cap = LZ4F_compressBound(lz4id->chunksize, &lz4id->prefs);   /* large enough for any input <= chunksize */
+	LOG_DBG("Buffer size needed %zu reserved %d\n",lz4id->cap,BUFFERSIZE);
 	
 
 	assert(LZ4F_HEADER_SIZE_MAX <= lz4id->cap);
 	assert(lz4id->cap <= BUFFERSIZE);
 
+	if (lz4acquire(lz4id) != LZ4_SUCCESS){
+		lz4abort(lz4id);
+		return LZ4_ERR_COMPRESS;
+	}
+
 	///Setup  compression context (if it is not allocated)
-	if (!lz4id->ctx){
-		handle_lz4error(LZ4F_createCompressionContext(&(lz4id->ctx), LZ4F_VERSION));
+	if (!lz4id->pctx->ctx){
+		if (handle_lz4error(LZ4F_createCompressionContext(&(lz4id->pctx->ctx), LZ4F_VERSION))){
+			lz4id->pctx->ctx=NULL;
+			lz4release(lz4id);
+			lz4abort(lz4id);
+			return LZ4_ERR_COMPRESS;
+		}
 	}
     	{
-		size_t const headerSize = LZ4F_compressBegin(lz4id->ctx, lz4id->destbuf, lz4id->cap, &kPrefs);
+		size_t const headerSize = LZ4F_compressBegin_usingCDict(lz4id->pctx->ctx, lz4id->pctx->destbuf, lz4id->cap, 
+				cdict, &lz4id->prefs);
         	if (handle_lz4error(headerSize)) {
+			lz4release(lz4id);
+			lz4abort(lz4id);
             		return LZ4_ERR_IO;
         	}
        		
+		/* reset statistics */
+		lz4id->nbytes=0;
+		XXH32_reset(&lz4id->xxh,0);
+		lz4id->hash=0;
+		lz4id->nwbuf=0;
+		lz4id->nwrites=0;
+		lz4id->nunsynced=0;
+		lz4id->maxunsynced=0;
+		lz4id->nsyncs=0;
+		lz4id->tsync=k_uptime_get();
+
 		//write the frameheader to the output file
-		const size_t written=fs_write(lz4id->fid,lz4id->destbuf, headerSize);
-		LOG_DBG("Written %d bytes into header",written);
-		if (handle_lz4error(written)){
+		if (lz4output(lz4id,lz4id->pctx->destbuf, headerSize) != LZ4_SUCCESS){
+			lz4release(lz4id);
+			lz4abort(lz4id);
 			return LZ4_ERR_IO;
 		}
+		LOG_DBG("Written %zu bytes into header",headerSize);
+	}
+	
+	if (lz4id->idx_interval > 0 && lz4id->sink == NULL && lz4openindex(lz4id) != LZ4_SUCCESS){
+		lz4release(lz4id);
+		lz4abort(lz4id);
+		return LZ4_ERR_IO;
 	}
 	
 	lz4id->isOpen=true;
@@ -114,60 +636,179 @@ int lz4open(const char * path, lz4streamfile * lz4id){
 }
 
 
-int lz4write(lz4streamfile * lz4id,const char * data){
-	size_t nwritten=0;
-
-	int ndata=0;
+/* compress a chunk of source data and possibly end the frame (runs in the writer thread when enabled) */
+static int lz4compress(lz4streamfile * lz4id, const char * src, size_t nsrc, int op, uint32_t mark){
+	lz4context * pctx=lz4id->pctx;
+	size_t nwritten;
 
-	if (data != NULL){
-		ndata=strlen(data);
-	}
-
-	/* compress srcbuffer if end of file or when new data does not fit */
-
-	if (CHUNKSIZE < (ndata +lz4id->nsrcdata) || (data == NULL && lz4id->nsrcdata > 0) ){
-
-		nwritten=LZ4F_compressUpdate(lz4id->ctx,lz4id->destbuf,lz4id->cap,lz4id->srcbuf,lz4id->nsrcdata,NULL);
-		lz4id->nsrcdata=0;
+	if (nsrc > 0){
+		nwritten=LZ4F_compressUpdate(pctx->ctx,pctx->destbuf,lz4id->cap,src,nsrc,NULL);
+		if (handle_lz4error(nwritten)){
+			return LZ4_ERR_COMPRESS;
+		}
 
 		if (nwritten > 0){
 			/* write compressed bytes to file if needed*/
 			assert(nwritten < BUFFERSIZE);
-			fs_write(lz4id->fid,lz4id->destbuf,nwritten);	
-			fs_sync(lz4id->fid);
+			if (lz4output(lz4id,pctx->destbuf,nwritten) != LZ4_SUCCESS){
+				return LZ4_ERR_IO;
+			}
 		}
+	}
+
+	if (op == LZ4_OP_MARK){
+		/* make sure that all data up to here ends up in the previous block */
+		nwritten=LZ4F_flush(pctx->ctx,pctx->destbuf,lz4id->cap,NULL);
+		if (handle_lz4error(nwritten)){
+			return LZ4_ERR_COMPRESS;
+		}
+		if (nwritten > 0 && lz4output(lz4id,pctx->destbuf,nwritten) != LZ4_SUCCESS){
+			return LZ4_ERR_IO;
+		}
+		struct lz4indexentry entry={sys_cpu_to_le32(mark),sys_cpu_to_le32((uint32_t)lz4id->nbytes)};
+		if (fs_write(&lz4id->idxfid,&entry,sizeof(entry)) != sizeof(entry)){
+			return LZ4_ERR_IO;
+		}
+	}
+
+	if (op == LZ4_OP_END){
+		/* Now end the compression frame*/
+		nwritten=LZ4F_compressEnd(pctx->ctx,pctx->destbuf,lz4id->cap,NULL);
 		if (handle_lz4error(nwritten)){
 			return LZ4_ERR_COMPRESS;
 		}
+		if (nwritten > 0){
+			assert(nwritten < BUFFERSIZE);
+			if (lz4output(lz4id,pctx->destbuf,nwritten) != LZ4_SUCCESS){
+				return LZ4_ERR_IO;
+			}
+		}
 	}
 
+	return lz4sync(lz4id,op == LZ4_OP_END);
+}
 
-	/*copy new data to the end of srcbuffer */
-	if (ndata > 0){
-		assert(ndata < CHUNKSIZE);
-		memcpy(&(lz4id->srcbuf[lz4id->nsrcdata]),data,ndata);
-		lz4id->nsrcdata+=ndata;
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
 
+static void lz4writer(void *p1, void *p2, void *p3){
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+	struct lz4job job;
+	
+	for (;;){
+		k_msgq_get(&lz4job_queue,&job,K_FOREVER);
+		int stat=lz4compress(job.lz4id,job.src,job.nsrc,job.op,job.mark);
+		if (stat != LZ4_SUCCESS){
+			job.lz4id->werr=stat;
+		}
+		/* release the buffer half */
+		k_sem_give(&job.lz4id->idle);
 	}
+}
+
+K_THREAD_DEFINE(lz4writer_id, CONFIG_LZ4STREAM_WRITER_STACK_SIZE, lz4writer, NULL, NULL, NULL, CONFIG_LZ4STREAM_WRITER_PRIORITY, 0, 0);
 
+/* wait until the writer thread has released the buffer half it is working on */
+static void lz4wait(lz4streamfile * lz4id){
+	if (k_sem_take(&lz4id->idle,K_NO_WAIT) != 0){
+		lz4id->nwaits++;
+		k_sem_take(&lz4id->idle,K_FOREVER);
+	}
+}
 
+/* hand the filled buffer half over to the writer thread and continue filling the other half */
+static int lz4submit(lz4streamfile * lz4id, int op, uint32_t mark){
+	lz4wait(lz4id);
 	
-	/* possibly finalize file */
-	if (data == NULL){
-		/* Now end the compression frame*/
-		nwritten=LZ4F_compressEnd(lz4id->ctx,lz4id->destbuf,lz4id->cap,NULL);
-		if (nwritten > 0){
-			assert(nwritten < BUFFERSIZE);
-			fs_write(lz4id->fid,lz4id->destbuf,nwritten);	
-			fs_sync(lz4id->fid);
+	struct lz4job job={lz4id, lz4id->fill, lz4id->nsrcdata, op, mark};
+	k_msgq_put(&lz4job_queue,&job,K_FOREVER);
+
+	lz4id->fill = (lz4id->fill == lz4id->srcbuf[0]) ? lz4id->srcbuf[1] : lz4id->srcbuf[0];
+	lz4id->nsrcdata=0;
+	lz4id->nswaps++;
+
+	/* errors from the writer thread are reported on the next handover */
+	int stat=lz4id->werr;
+	lz4id->werr=LZ4_SUCCESS;
+	return stat;
+}
+
+/* block until all handed over data has been written */
+static int lz4drain(lz4streamfile * lz4id){
+	lz4wait(lz4id);
+	k_sem_give(&lz4id->idle);
+	int stat=lz4id->werr;
+	lz4id->werr=LZ4_SUCCESS;
+	return stat;
+}
+
+#else
+
+static int lz4submit(lz4streamfile * lz4id, int op, uint32_t mark){
+	int stat=lz4compress(lz4id,lz4id->fill,lz4id->nsrcdata,op,mark);
+	lz4id->nsrcdata=0;
+	return stat;
+}
+
+static int lz4drain(lz4streamfile * lz4id){
+	ARG_UNUSED(lz4id);
+	return LZ4_SUCCESS;
+}
+
+#endif
+
+/* flush pending data and end the compression frame */
+static int lz4finish(lz4streamfile * lz4id){
+	int stat=lz4submit(lz4id,LZ4_OP_END,0);
+	int dstat=lz4drain(lz4id);
+	return (stat != LZ4_SUCCESS) ? stat : dstat;
+}
+
+int lz4write_n(lz4streamfile * lz4id, const void * data, size_t ndata){
+	const char * src=data;
+	int stat=LZ4_SUCCESS;
+
+	/* copy data into srcbuffer, compressing full chunks as we go (data larger than a chunk is split) */
+	while (ndata > 0){
+		if (lz4id->nsrcdata == lz4id->chunksize){
+			int cstat=lz4submit(lz4id,LZ4_OP_UPDATE,0);
+			if (stat == LZ4_SUCCESS){
+				stat=cstat;
+			}
 		}
+		size_t ncopy=MIN(ndata,lz4id->chunksize-lz4id->nsrcdata);
+		memcpy(&(lz4id->fill[lz4id->nsrcdata]),src,ncopy);
+		lz4id->nsrcdata+=ncopy;
+		src+=ncopy;
+		ndata-=ncopy;
 	}
 
-	if (handle_lz4error(nwritten)){
-		return LZ4_ERR_COMPRESS;
+	return stat;
+}
+
+/* Notify the current (UTC) time of the data which is about to be written.
+ * When the index is enabled, a new block is started each time a new interval is entered */
+int lz4mark(lz4streamfile * lz4id, uint32_t utc){
+	if (!lz4id->idxOpen){
+		return LZ4_SUCCESS;
+	}
+	
+	uint32_t slot=utc/lz4id->idx_interval;
+	if (lz4id->nmarks > 0 && slot == lz4id->lastslot){
+		return LZ4_SUCCESS;
 	}
+	lz4id->lastslot=slot;
+	lz4id->nmarks++;
+	return lz4submit(lz4id,LZ4_OP_MARK,utc);
+}
 
-	return LZ4_SUCCESS;
+int lz4write(lz4streamfile * lz4id,const char * data){
+	/* a NULL pointer finalizes the file */
+	if (data == NULL){
+		return lz4finish(lz4id);
+	}
+	return lz4write_n(lz4id,data,strlen(data));
 }
 
 int lz4close(lz4streamfile * lz4id){
@@ -177,26 +818,64 @@ int lz4close(lz4streamfile * lz4id){
 		return LZ4F_ERROR_GENERIC;
 	}
 
-	lz4write(lz4id,NULL);	
-	fs_close(lz4id->fid);
-	k_free(lz4id->fid);
-	if (!lz4id->reuseContext){
-		LZ4F_freeCompressionContext(lz4id->ctx);
+	int stat=lz4finish(lz4id);
+	lz4id->hash=XXH32_digest(&lz4id->xxh);
+	if (lz4id->sink != NULL){
+		if (lz4id->sink->close(lz4id->sink->ctx) != 0){
+			LOG_ERR("Cannot close lz4 output sink");
+			if (stat == LZ4_SUCCESS){
+				stat=LZ4_ERR_IO;
+			}
+		}
+		lz4release(lz4id);
+	}else if (stat != LZ4_SUCCESS){
+		/* keep the temporary names, so that lz4recover() repairs the file after a restart */
+		LOG_ERR("Cannot finish lz4 file %s, leaving it for recovery",lz4id->filename);
+		fs_close(&lz4id->fid);
+		if (lz4id->idxOpen){
+			fs_close(&lz4id->idxfid);
+			lz4id->idxOpen=false;
+		}
+		lz4release(lz4id);
+	}else{
+		if (lz4id->nalloc > lz4id->nbytes){
+			/* trim the unused part of the preallocated file */
+			fs_truncate(&lz4id->fid,lz4id->nbytes);
+			LOG_INF("Preallocated %u bytes (%s), used %u",(unsigned)lz4id->prealloc,
+					lz4id->contiguous ? "contiguous" : "fragmented",(unsigned)lz4id->nbytes);
+		}
+		fs_close(&lz4id->fid);
+		lz4closeindex(lz4id);
+		lz4release(lz4id);
+
+		/*rename temporary file */
+		char pathtmp[204];
+		tempname(pathtmp,lz4id->filename);
+		
+		fs_rename(pathtmp,lz4id->filename);
 	}
-	
-	
-	/*rename temporary file */
-	char pathtmp[204];
-	tempname(pathtmp,lz4id->filename);
-	
-	fs_rename(pathtmp,lz4id->filename);
 
 	lz4id->isOpen=false;
 	strcpy(lz4id->filename,"");
 
+#if defined(CONFIG_LZ4STREAM_STATIC_ARENA) && defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+	struct sys_memory_stats arenastats;
+	if (sys_heap_runtime_stats_get(&lz4arena.heap,&arenastats) == 0){
+		LOG_INF("lz4 arena: %u bytes in use, peak %u of %u bytes",(unsigned)arenastats.allocated_bytes,
+				(unsigned)arenastats.max_allocated_bytes,CONFIG_LZ4STREAM_ARENA_SIZE);
+	}
+#endif
+	LOG_INF("Written %zu bytes in %u writes and %u syncs (at most %zu bytes unsynced)",lz4id->nbytes,lz4id->nwrites,
+			lz4id->nsyncs,lz4id->maxunsynced);
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+	LOG_INF("lz4 writer: producer waited on %u out of %u buffer handovers",lz4id->nwaits,lz4id->nswaps);
+#endif
 	/*k_free(lz4id);*/
 	/*lz4id=NULL;*/
 
+	if (stat != LZ4_SUCCESS){
+		return stat;
+	}
 	LOG_DBG("Successfully closed file\n");
 	return LZ4_SUCCESS;
 
@@ -204,6 +883,178 @@ int lz4close(lz4streamfile * lz4id){
 
 
 
+/* frame magic number and header flags (see the lz4 frame format description) */
+#define LZ4_FRAME_MAGIC 0x184D2204U
+#define LZ4_FLG_BLOCKCHECKSUM 0x10
+#define LZ4_FLG_CONTENTCHECKSUM 0x04
+#define LZ4_BLOCK_UNCOMPRESSED 0x80000000U
+
+static uint32_t readLE32(const uint8_t * buf){
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/* verify the checksum of the block of which the header has just been read */
+static bool lz4checkblock(struct fs_file_t * fid, uint32_t blocksize){
+	uint8_t buf[128];
+	XXH32_state_t state;
+
+	XXH32_reset(&state,0);
+	while (blocksize > 0){
+		size_t n=MIN(blocksize,sizeof(buf));
+		if (fs_read(fid,buf,n) != (ssize_t)n){
+			return false;
+		}
+		XXH32_update(&state,buf,n);
+		blocksize-=n;
+	}
+	if (fs_read(fid,buf,LZ4F_BLOCK_CHECKSUM_SIZE) != LZ4F_BLOCK_CHECKSUM_SIZE){
+		return false;
+	}
+	return readLE32(buf) == XXH32_digest(&state);
+}
+
+/* Repair an unfinished lz4 file (left with a .tmp suffix after e.g. a power loss) and rename it.
+ * Only the block headers are visited: the file is truncated after the last complete block
+ * and a frame end mark is appended. When the blocks have checksums (preallocated files, which
+ * still contain old data after the written blocks) the checksum of every block is verified and
+ * the file is truncated after the end mark. Index sidecars are simply renamed (entries pointing
+ * beyond the recovered data must be ignored by readers). Returns LZ4_SUCCESS or an error code */
+int lz4recover(const char * pathtmp){
+	char path[204];
+	uint8_t header[LZ4F_HEADER_SIZE_MAX];
+	uint8_t blockhdr[LZ4F_BLOCK_HEADER_SIZE];
+	struct fs_file_t fid;
+	struct fs_dirent entry;
+	int stat=LZ4_SUCCESS;
+
+	size_t npath=strlen(pathtmp);
+	if (npath < 4 || npath >= sizeof(path) || strcmp(pathtmp+npath-4,".tmp") != 0){
+		LOG_ERR("Not a temporary lz4 file: %s",pathtmp);
+		return LZ4_ERR_IO;
+	}
+	memcpy(path,pathtmp,npath-4);
+	path[npath-4]='\0';
+
+	if (fs_stat(pathtmp,&entry) != 0){
+		return LZ4_ERR_IO;
+	}
+	const off_t filesize=entry.size;
+
+	if (npath > 8 && strcmp(pathtmp+npath-8,".idx.tmp") == 0){
+		/* index sidecar: drop a partially written entry */
+		fs_file_t_init(&fid);
+		if (fs_open(&fid,pathtmp,FS_O_WRITE) != 0){
+			LOG_ERR("Cannot open %s for recovery",pathtmp);
+			return LZ4_ERR_IO;
+		}
+		if (filesize < (off_t)sizeof(struct lz4indexheader)){
+			/* the header itself is incomplete: write an empty index (interval unknown) */
+			struct lz4indexheader header={LZ4_INDEX_MAGIC,LZ4_INDEX_VERSION,{0,0,0},0};
+			if (fs_truncate(&fid,0) != 0 || fs_write(&fid,&header,sizeof(header)) != sizeof(header)){
+				stat=LZ4_ERR_IO;
+			}
+		}else{
+			off_t nentries=(filesize-(off_t)sizeof(struct lz4indexheader))/(off_t)sizeof(struct lz4indexentry);
+			if (fs_truncate(&fid,sizeof(struct lz4indexheader)+nentries*sizeof(struct lz4indexentry)) != 0){
+				stat=LZ4_ERR_IO;
+			}
+		}
+		fs_close(&fid);
+		if (stat != LZ4_SUCCESS){
+			LOG_ERR("Cannot repair the index %s",pathtmp);
+			return stat;
+		}
+		return (fs_rename(pathtmp,path) == 0) ? LZ4_SUCCESS : LZ4_ERR_IO;
+	}
+
+	fs_file_t_init(&fid);
+	if (fs_open(&fid,pathtmp,FS_O_READ|FS_O_WRITE) != 0){
+		LOG_ERR("Cannot open %s for recovery",pathtmp);
+		return LZ4_ERR_IO;
+	}
+
+	/* check the frame header */
+	ssize_t nread=fs_read(&fid,header,sizeof(header));
+	size_t headersize=0;
+	if (nread >= LZ4F_MIN_SIZE_TO_KNOW_HEADER_LENGTH && readLE32(header) == LZ4_FRAME_MAGIC){
+		headersize=LZ4F_headerSize(header,nread);
+		if (LZ4F_isError(headersize) || headersize > (size_t)nread){
+			headersize=0;
+		}
+	}
+
+	if (headersize == 0){
+		/* nothing useful has been written */
+		fs_close(&fid);
+		LOG_WRN("Removing %s which does not contain a valid lz4 frame header",pathtmp);
+		fs_unlink(pathtmp);
+		return LZ4_ERR_COMPRESS;
+	}
+
+	const uint8_t flg=header[4];
+	const size_t blockmax=(size_t)1 << (8+2*((header[5] >> 4) & 0x07));
+	const size_t checksumsize=(flg & LZ4_FLG_BLOCKCHECKSUM) ? LZ4F_BLOCK_CHECKSUM_SIZE : 0;
+	
+	/* walk the block headers up to the last complete block */
+	off_t offset=headersize;
+	bool finished=false;
+	size_t nblocks=0;
+	while (offset + LZ4F_BLOCK_HEADER_SIZE <= filesize){
+		if (fs_seek(&fid,offset,FS_SEEK_SET) != 0 || fs_read(&fid,blockhdr,LZ4F_BLOCK_HEADER_SIZE) != LZ4F_BLOCK_HEADER_SIZE){
+			break;
+		}
+		const uint32_t blocksize=readLE32(blockhdr) & ~LZ4_BLOCK_UNCOMPRESSED;
+		if (blocksize == 0){
+			/* end mark: the frame was finished, but the file was not renamed */
+			finished=true;
+			break;
+		}
+		const off_t next=offset+LZ4F_BLOCK_HEADER_SIZE+blocksize+checksumsize;
+		if (blocksize > blockmax || next > filesize){
+			break;
+		}
+		if (checksumsize > 0 && !lz4checkblock(&fid,blocksize)){
+			break;
+		}
+		offset=next;
+		nblocks++;
+	}
+
+	if (!finished){
+		LOG_INF("Recovering %d blocks (%d of %d bytes) from %s",(int)nblocks,(int)offset,(int)filesize,pathtmp);
+		if (flg & LZ4_FLG_CONTENTCHECKSUM){
+			/* the content checksum cannot be computed without decompressing: drop it from the header */
+			header[4]=flg & ~LZ4_FLG_CONTENTCHECKSUM;
+			header[headersize-1]=(uint8_t)((XXH32(&header[4],headersize-5,0) >> 8) & 0xFF);
+			if (fs_seek(&fid,0,FS_SEEK_SET) != 0 || fs_write(&fid,header,headersize) != (ssize_t)headersize){
+				stat=LZ4_ERR_IO;
+			}
+		}
+		memset(blockhdr,0,sizeof(blockhdr));
+		if (stat != LZ4_SUCCESS || fs_truncate(&fid,offset) != 0 || fs_seek(&fid,offset,FS_SEEK_SET) != 0 
+				|| fs_write(&fid,blockhdr,sizeof(blockhdr)) != sizeof(blockhdr)){
+			stat=LZ4_ERR_IO;
+		}
+	}else{
+		/* drop the unused part of a preallocated file */
+		const off_t end=offset+LZ4F_BLOCK_HEADER_SIZE+((flg & LZ4_FLG_CONTENTCHECKSUM) ? 4 : 0);
+		if (end < filesize && fs_truncate(&fid,end) != 0){
+			stat=LZ4_ERR_IO;
+		}
+	}
+
+	fs_close(&fid);
+
+	if (stat == LZ4_SUCCESS && fs_rename(pathtmp,path) != 0){
+		stat=LZ4_ERR_IO;
+	}
+	if (stat != LZ4_SUCCESS){
+		LOG_ERR("Failed to recover %s",pathtmp);
+	}
+	return stat;
+}
+
+
  /*TESTING MAIN function */
 /*int main(){*/
 	/*char * filename ="orig.lz4";*/
@@ -4,7 +4,8 @@
 * SPDX-License-Identifier: Apache-2.0
 */
 
-
+#ifndef LZ4FILE_H
+#define LZ4FILE_H
 
 #define LZ4_ERR_OVERSIZED -1
 #define LZ4_SUCCESS  0
@@ -12,33 +13,141 @@
 #define LZ4_ERR_IO -3
 
 /*
- * CHUNKSIZE (maximum size of the input src data)
+ * Sync policies: when to flush written data to the sdcard using fs_sync
+ */
+#define LZ4_SYNC_ALWAYS 0 /* after every compressed chunk */
+#define LZ4_SYNC_BYTES 1 /* when at least sync_arg bytes have been written since the last sync */
+#define LZ4_SYNC_INTERVAL 2 /* when at least sync_arg seconds have passed since the last sync */
+#define LZ4_SYNC_CLOSE 3 /* only when the file is closed */
+
+/*
+ * CHUNKSIZE (maximum size of the input src data, streams may use smaller chunks)
 */
 
-#define CHUNKSIZE 4096
-/* buffer size determined by trial and error */
-#define BUFFERSIZE 4200 
+#define CHUNKSIZE CONFIG_LZ4STREAM_MAX_CHUNK_SIZE
+/* worst case compressed size of a chunk, plus room for block header, checksums and end mark (4200 for 4096 byte chunks) */
+#define BUFFERSIZE (CHUNKSIZE+CHUNKSIZE/255+88)
+
+/* output is written to the file in whole sectors (see CONFIG_LZ4STREAM_WRITE_BUFFER_SIZE) */
+#define LZ4_SECTOR_SIZE 512
+#define LZ4_WBUFSIZE (CONFIG_LZ4STREAM_WRITE_BUFFER_SIZE/LZ4_SECTOR_SIZE*LZ4_SECTOR_SIZE)
+
+/*
+ * With the writer thread enabled, the source buffer is split in two halves:
+ * one is filled by lz4write() while the other is compressed and written to
+ * the sdcard by the writer thread
+ */
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+#define LZ4_NSRCBUF 2
+#else
+#define LZ4_NSRCBUF 1
+#endif
+
+/* size of the chunk buffer to provide to init_lz4stream() for a given chunk size */
+#define LZ4_CHUNKBUF_SIZE(chunksize) (LZ4_NSRCBUF*(chunksize))
 /*
  * Struct holding the administrative parts of an open lz4stream
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
 #include "lz4frame_static.h"
+/* the hash of a file is computed while it is written */
+#ifndef XXH_STATIC_LINKING_ONLY
+#define XXH_STATIC_LINKING_ONLY
+#endif
+#include "xxhash.h"
 
 
-typedef struct lz4streamfile {
+/*
+ * Preset dictionary which can be shared by several streams
+ */
+typedef struct lz4dict {
+	LZ4F_CDict * cdict;
+	uint32_t id; /* dictionary ID recorded in the frame header */
+}lz4dict;
+
+/*
+ * Compression context and output buffer from a shared pool, used by one open stream at a time
+ */
+typedef struct lz4context {
 	LZ4F_compressionContext_t ctx;
-	struct fs_file_t * fid;
-	size_t cap;
 	char destbuf[BUFFERSIZE];
-	char srcbuf[CHUNKSIZE];
+#if LZ4_WBUFSIZE > 0
+	char wbuf[LZ4_WBUFSIZE] __aligned(4); /* compressed data not yet written to the file */
+#endif
+	bool inUse;
+}lz4context;
+
+/*
+ * Destination of a stream other than a file on the file system (e.g. a raw partition of the sdcard),
+ * see lz4setsink(). The functions return 0 on success. Writes are not aligned or buffered by the stream
+ */
+typedef struct lz4sink {
+	int (*open)(void * ctx, const char * path);
+	int (*write)(void * ctx, const void * buf, size_t nbuf);
+	int (*sync)(void * ctx);
+	int (*close)(void * ctx);
+	void * ctx;
+}lz4sink;
+
+typedef struct lz4streamfile {
+	lz4context * pctx; /* pooled context (remembered after closing, so it is preferably reused) */
+	struct fs_file_t fid;
+	size_t cap;
+	char * srcbuf[LZ4_NSRCBUF]; /* chunk buffer(s) provided by the user */
+	size_t chunksize;
+	char * fill; /* part of srcbuf which is currently being filled */
 	char filename[200];
-	int nsrcdata;
+	size_t nsrcdata;
 	bool isOpen;
         bool reuseContext;
+	bool independent; /* use independent blocks even without index */
+	LZ4F_preferences_t prefs;
+	const lz4dict * dict;
+	const lz4sink * sink; /* NULL: write to the file system */
+	uint32_t idx_interval; /* seconds between index entries (0: no index) */
+	struct fs_file_t idxfid;
+	bool idxOpen;
+	uint32_t lastslot; /* last index interval for which an entry was written */
+	uint32_t nmarks;
+	int sync_policy;
+	uint32_t sync_arg;
+	int64_t tsync; /* uptime of the last sync [ms] */
+	/* statistics of the currently open file */
+	size_t nbytes; /* total number of bytes written to the file */
+	size_t nwbuf; /* bytes in the write buffer of the context */
+	uint32_t nwrites; /* number of fs_write calls */
+	size_t nunsynced; /* bytes written since the last sync */
+	size_t maxunsynced; /* largest amount of bytes written between two syncs */
+	uint32_t nsyncs;
+	XXH32_state_t xxh; /* of the bytes written to the file */
+	uint32_t hash; /* XXH32 (seed 0) of the complete file, set when it is closed */
+	size_t prealloc; /* bytes to allocate up front when opening the file (0: grow while writing) */
+	size_t nalloc; /* size of the file on disk while it is open (at least nbytes) */
+	bool contiguous; /* the preallocated clusters are contiguous */
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+	struct k_sem idle; /* available when the writer thread is done with the other half */
+	int werr; /* last error reported by the writer thread */
+	uint32_t nswaps; /* number of buffer halves handed over to the writer */
+	uint32_t nwaits; /* number of handovers where lz4write() had to wait for the writer */
+#endif
 }lz4streamfile;
 
 int lz4open(const char *path, lz4streamfile * lz4id);
 int lz4write(lz4streamfile * lz4id, const char * data);
+int lz4write_n(lz4streamfile * lz4id, const void * data, size_t ndata);
 int lz4close(lz4streamfile *lz4id);
-void init_lz4stream(lz4streamfile * lz4id, const bool reuseContext);
+int lz4recover(const char * pathtmp);
+void init_lz4stream(lz4streamfile * lz4id, char * chunkbuf, size_t chunksize, const bool reuseContext);
+void lz4setsync(lz4streamfile * lz4id, int policy, uint32_t arg);
+void lz4setprealloc(lz4streamfile * lz4id, size_t size);
+void lz4setsink(lz4streamfile * lz4id, const lz4sink * sink);
+void lz4setindex(lz4streamfile * lz4id, uint32_t interval);
+void lz4setindependent(lz4streamfile * lz4id, bool independent);
+int lz4setlevel(lz4streamfile * lz4id, int level);
+int lz4mark(lz4streamfile * lz4id, uint32_t utc);
+int lz4loaddict(const char * path, lz4dict * dict);
+void lz4setdict(lz4streamfile * lz4id, const lz4dict * dict);
+
+#endif /* LZ4FILE_H */
@@ -61,6 +61,16 @@
 #  define LZ4F_HEAPMODE 1
 #endif
 
+/*
+ * LZ4F_CDICT_FASTONLY :
+ * Only digest dictionaries for the fast compressor (compression levels < LZ4HC_CLEVEL_MIN).
+ * Avoids allocating an LZ4_streamHC_t (~256 KB) per dictionary on memory constrained targets.
+ * Using such a dictionary with HC compression levels compresses without the dictionary.
+ */
+#ifndef LZ4F_CDICT_FASTONLY
+#  define LZ4F_CDICT_FASTONLY 0
+#endif
+
 
 /*-************************************
 *  Memory routines
@@ -72,10 +82,21 @@
  * by modifying below section.
  */
 #ifndef LZ4_SRC_INCLUDED   /* avoid redefinition when sources are coalesced */
-#  include <stdlib.h>   /* malloc, calloc, free */
-#  define ALLOC(s)          malloc(s)
-#  define ALLOC_AND_ZERO(s) calloc(1,(s))
-#  define FREEMEM(p)        free(p)
+#  ifdef LZ4_USER_MEMORY_FUNCTIONS
+/* memory management functions can be customized by user project (as in lz4.c) */
+#    include <stddef.h>   /* size_t */
+void* LZ4_malloc(size_t s);
+void* LZ4_calloc(size_t n, size_t s);
+void  LZ4_free(void* p);
+#    define ALLOC(s)          LZ4_malloc(s)
+#    define ALLOC_AND_ZERO(s) LZ4_calloc(1,(s))
+#    define FREEMEM(p)        LZ4_free(p)
+#  else
+#    include <stdlib.h>   /* malloc, calloc, free */
+#    define ALLOC(s)          malloc(s)
+#    define ALLOC_AND_ZERO(s) calloc(1,(s))
+#    define FREEMEM(p)        free(p)
+#  endif
 #endif
 
 #include <string.h>   /* memset, memcpy, memmove */
@@ -499,15 +520,22 @@ LZ4F_CDict* LZ4F_createCDict(const void* dictBuffer, size_t dictSize)
     }
     cdict->dictContent = ALLOC(dictSize);
     cdict->fastCtx = LZ4_createStream();
+#if LZ4F_CDICT_FASTONLY
+    cdict->HCCtx = NULL;
+    if (!cdict->dictContent || !cdict->fastCtx) {
+#else
     cdict->HCCtx = LZ4_createStreamHC();
     if (!cdict->dictContent || !cdict->fastCtx || !cdict->HCCtx) {
+#endif
         LZ4F_freeCDict(cdict);
         return NULL;
     }
     memcpy(cdict->dictContent, dictStart, dictSize);
     LZ4_loadDict (cdict->fastCtx, (const char*)cdict->dictContent, (int)dictSize);
+#if !LZ4F_CDICT_FASTONLY
     LZ4_setCompressionLevel(cdict->HCCtx, LZ4HC_CLEVEL_DEFAULT);
     LZ4_loadDictHC(cdict->HCCtx, (const char*)cdict->dictContent, (int)dictSize);
+#endif
     return cdict;
 }
 
@@ -81,7 +81,11 @@ typedef enum { noDictCtx, usingDictCtxHc } dictCtx_directive;
 #define MAX(a,b)   ( (a) > (b) ? (a) : (b) )
 #define HASH_FUNCTION(i)         (((i) * 2654435761U) >> ((MINMATCH*8)-LZ4HC_HASH_LOG))
 #define DELTANEXTMAXD(p)         chainTable[(p) & LZ4HC_MAXD_MASK]    /* flexible, LZ4HC_MAXD dependent */
-#define DELTANEXTU16(table, pos) table[(U16)(pos)]   /* faster */
+#if LZ4HC_DICTIONARY_LOGSIZE < 16
+#  define DELTANEXTU16(table, pos) table[(pos) & LZ4HC_MAXD_MASK]   /* reduced chain table */
+#else
+#  define DELTANEXTU16(table, pos) table[(U16)(pos)]   /* faster */
+#endif
 /* Make fields passed to, and updated by LZ4HC_encodeSequence explicit */
 #define UPDATABLE(ip, op, anchor) &ip, &op, &anchor
 
@@ -189,11 +189,18 @@ LZ4LIB_API int LZ4_saveDictHC (LZ4_streamHC_t* streamHCPtr, char* safeBuffer, in
  * Even then, only do so in the context of static linking, as definitions may change between versions.
  ********************************************************************/
 
+/* LZ4HC_DICTIONARY_LOGSIZE (<= 16) and LZ4HC_HASH_LOG can be lowered at compile time to shrink the
+ * HC state for memory constrained targets. Fewer match candidates are found, but the output stays valid.
+ * The state size then differs from other builds, so only do this when linking the library statically. */
+#ifndef LZ4HC_DICTIONARY_LOGSIZE
 #define LZ4HC_DICTIONARY_LOGSIZE 16
+#endif
 #define LZ4HC_MAXD (1<<LZ4HC_DICTIONARY_LOGSIZE)
 #define LZ4HC_MAXD_MASK (LZ4HC_MAXD - 1)
 
+#ifndef LZ4HC_HASH_LOG
 #define LZ4HC_HASH_LOG 15
+#endif
 #define LZ4HC_HASHTABLESIZE (1 << LZ4HC_HASH_LOG)
 #define LZ4HC_HASH_MASK (LZ4HC_HASHTABLESIZE - 1)
 
@@ -220,7 +227,11 @@ struct LZ4HC_CCtx_internal
 /* Do not use these definitions directly !
  * Declare or allocate an LZ4_streamHC_t instead.
  */
+#if (LZ4HC_DICTIONARY_LOGSIZE == 16) && (LZ4HC_HASH_LOG == 15)
 #define LZ4_STREAMHCSIZE       262200  /* static size, for inter-version compatibility */
+#else
+#define LZ4_STREAMHCSIZE       (4*LZ4HC_HASHTABLESIZE + 2*LZ4HC_MAXD + 56 + ((sizeof(void*)==16) ? 56 : 0))  /* reduced tables */
+#endif
 #define LZ4_STREAMHCSIZE_VOIDP (LZ4_STREAMHCSIZE / sizeof(void*))
 union LZ4_streamHC_u {
     void* table[LZ4_STREAMHCSIZE_VOIDP];
@@ -8,9 +8,19 @@
 #include "config.h"
 #include "featherw_datalogger.h"
 #include "led_buttons.h"
+#include "lz4file.h"
+#include "gnss.h"
+#include "pipeline.h"
+#ifdef CONFIG_GNSSR_RAWLOG
+#include "rawlog.h"
+#endif
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+#include "upload_manifest.h"
+#endif
 #include <zephyr/fs/fs.h>
 #include <string.h>
 #include <zephyr/sys/base64.h>
+#include <zephyr/sys/util.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(GNSSR,CONFIG_GNSSR_LOG_LEVEL);
 
@@ -30,6 +40,16 @@ void set_defaults(struct config * conf){
 	conf->agps=0;
 	conf->psm_mode=0;
 	conf->pvt_low=1;
+	/* sync log files once a minute */
+	conf->sync_mode=LZ4_SYNC_INTERVAL;
+	conf->sync_value=60;
+	/* no index: independent blocks compress worse */
+	conf->index_interval=0;
+	conf->prealloc_kb=0;
+	conf->log_mode=LOG_MODE_NMEA;
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+	nmea_filter_defaults(&conf->nmea_filter);
+#endif
 #ifdef CONFIG_SUPL_CLIENT_LIB
 	conf->agps=1;
 #endif
@@ -67,6 +87,72 @@ void replace_lineend(char * intls)
     }
 }
 
+/* retrieve an optional integer item, the value is left untouched when the item is absent */
+static void get_optional_int(const cJSON *monitor, const char *key, int *value){
+	cJSON *item= cJSON_GetObjectItemCaseSensitive(monitor, key);
+	if (cJSON_IsNumber(item)){
+		*value=item->valueint;
+	}
+}
+
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+/* bits of a list of names, or the given default when the list is absent */
+static uint8_t get_name_list(const cJSON *filter, const char *key, uint8_t (*lookup)(const char *), uint8_t bits){
+	cJSON *list= cJSON_GetObjectItemCaseSensitive(filter, key);
+	cJSON *elem;
+	if (!cJSON_IsArray(list)){
+		return bits;
+	}
+	bits=0;
+	cJSON_ArrayForEach(elem,list){
+		uint8_t bit=cJSON_IsString(elem) ? lookup(elem->valuestring) : 0;
+		if (bit == 0){
+			LOG_WRN("ignoring unknown item in nmea_filter %s",key);
+		}
+		bits|=bit;
+	}
+	return bits;
+}
+
+/* retrieve the optional NMEA filter settings, absent items keep their default */
+static void get_nmea_filter(const cJSON *monitor, struct nmea_filter_config *flt){
+	cJSON *filter= cJSON_GetObjectItemCaseSensitive(monitor, "nmea_filter");
+	if (!cJSON_IsObject(filter)){
+		return;
+	}
+	flt->sentences=get_name_list(filter,"sentences",nmea_filter_sentence,flt->sentences);
+	flt->constellations=get_name_list(filter,"constellations",nmea_filter_constellation,flt->constellations);
+
+	int value=flt->elev_min;
+	get_optional_int(filter,"elev_min",&value);
+	flt->elev_min=CLAMP(value,-90,90);
+	value=flt->elev_max;
+	get_optional_int(filter,"elev_max",&value);
+	flt->elev_max=CLAMP(value,-90,90);
+	value=flt->rmc_interval;
+	get_optional_int(filter,"rmc_interval",&value);
+	flt->rmc_interval=CLAMP(value,1,86400/2);
+
+	/* azimuth windows: [[from,to],...] in degrees, clockwise */
+	cJSON *windows= cJSON_GetObjectItemCaseSensitive(filter, "azimuths");
+	cJSON *window;
+	if (cJSON_IsArray(windows)){
+		flt->nwindows=0;
+		cJSON_ArrayForEach(window,windows){
+			cJSON *from=cJSON_GetArrayItem(window,0);
+			cJSON *to=cJSON_GetArrayItem(window,1);
+			if (!cJSON_IsNumber(from) || !cJSON_IsNumber(to) || flt->nwindows == NMEA_FILTER_MAX_WINDOWS){
+				LOG_WRN("ignoring azimuth window in nmea_filter");
+				continue;
+			}
+			flt->azimuth[flt->nwindows][0]=(from->valueint%360+360)%360;
+			flt->azimuth[flt->nwindows][1]=(to->valueint%360+360)%360;
+			flt->nwindows++;
+		}
+	}
+}
+#endif
+
 int read_config(struct config *conf){
 	char configfile[100];
 	if(get_sd_config_path(configfile,"config_" CONFIG_GNSSR_VERSION ".json")!= FEA_SUCCESS){
@@ -76,6 +162,9 @@ int read_config(struct config *conf){
 	struct fs_file_t fid;
 	fs_file_t_init(&fid);
 
+	/* start from defaults, so that optional items can be omitted from the config file */
+	set_defaults(conf);
+
 	if (file_exists(configfile)){
 		LOG_INF("Reading config from %s\n",configfile);
 		/* read from file */
@@ -84,9 +173,24 @@ int read_config(struct config *conf){
 			return CONF_ERR;
 
 		}
-		ssize_t buflen=fs_gets(jsonbuf,JSONBUFLEN,&fid);
+		/* the whole file needs to fit in the buffer, a truncated config would be parsed partially */
+		char readbuf[64];
+		struct fs_reader rd;
+		fs_reader_init(&rd,&fid,readbuf,sizeof(readbuf));
+		ssize_t buflen=fs_reader_read(&rd,jsonbuf,JSONBUFLEN-1);
+		bool complete=fs_reader_eof(&rd);
 		fs_close(&fid);
 		/*int expected_return_code = (1 << ARRAY_SIZE(config_descr)) - 1;*/
+		if (buflen < 0){
+			LOG_ERR("cannot read configfile %s",configfile);
+			return CONF_ERR;
+		}
+		if (!complete){
+			LOG_ERR("configfile %s is larger (%u bytes) than the %d bytes which can be read",configfile,
+					(unsigned)file_size(configfile),JSONBUFLEN-1);
+			return CONF_ERR;
+		}
+		jsonbuf[buflen]='\0';
 			
 		LOG_INF("buflen %d\n",buflen);
 
@@ -116,6 +220,15 @@ int read_config(struct config *conf){
 
 		conf->agps=agps->valueint;
 
+		get_optional_int(monitor,"sync_mode",&conf->sync_mode);
+		get_optional_int(monitor,"sync_value",&conf->sync_value);
+		get_optional_int(monitor,"index_interval",&conf->index_interval);
+		get_optional_int(monitor,"prealloc_kb",&conf->prealloc_kb);
+		get_optional_int(monitor,"log_mode",&conf->log_mode);
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+		get_nmea_filter(monitor,&conf->nmea_filter);
+#endif
+
 		cJSON * filebase=cJSON_GetObjectItemCaseSensitive(monitor,"filebase");
 
 		strcpy(conf->filebase,filebase->valuestring);
@@ -179,15 +292,30 @@ int read_config(struct config *conf){
 	}else{
 		/* write defaults to file */
 		LOG_INF("Writing defaults to configfile %s",configfile);
-		set_defaults(conf);		
 		
 		cJSON * monitor = cJSON_CreateObject();
 		cJSON_AddNumberToObject(monitor,"upload",conf->upload);
 		cJSON_AddNumberToObject(monitor,"agps",conf->upload);
 		cJSON_AddNumberToObject(monitor,"psm_mode",conf->psm_mode);
 		cJSON_AddNumberToObject(monitor,"pvt_low",conf->pvt_low);
+		cJSON_AddNumberToObject(monitor,"sync_mode",conf->sync_mode);
+		cJSON_AddNumberToObject(monitor,"sync_value",conf->sync_value);
+		cJSON_AddNumberToObject(monitor,"index_interval",conf->index_interval);
+		cJSON_AddNumberToObject(monitor,"prealloc_kb",conf->prealloc_kb);
+		cJSON_AddNumberToObject(monitor,"log_mode",conf->log_mode);
 		cJSON_AddStringToObject(monitor,"filebase",conf->filebase);
 
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+		/* the filter keeps everything by default (constellations are all kept when the list is absent) */
+		static const char * const sentences[]={"GSV","RMC"};
+		cJSON * nmea_filter= cJSON_AddObjectToObject(monitor, "nmea_filter");
+		cJSON_AddItemToObject(nmea_filter,"sentences",cJSON_CreateStringArray(sentences,ARRAY_SIZE(sentences)));
+		cJSON_AddNumberToObject(nmea_filter,"elev_min",conf->nmea_filter.elev_min);
+		cJSON_AddNumberToObject(nmea_filter,"elev_max",conf->nmea_filter.elev_max);
+		cJSON_AddArrayToObject(nmea_filter,"azimuths");
+		cJSON_AddNumberToObject(nmea_filter,"rmc_interval",conf->nmea_filter.rmc_interval);
+#endif
+
 #ifdef CONFIG_GNSSR_VERSION
 		cJSON_AddStringToObject(monitor,"version",CONFIG_GNSSR_VERSION);
 #endif
@@ -246,6 +374,49 @@ int get_jsonstatus(char *jsonbuffer, int buflen){
 			cJSON *batmvolt=cJSON_CreateNumber(dev_status.battery_mvolt[i]);
 			cJSON_AddItemToArray(bat_array, batmvolt);
 		}
+		dev_status.gnss_ring_peak=gnss_get_ring_peak();
+		cJSON_AddNumberToObject(monitor,"gnss_ring_peak",dev_status.gnss_ring_peak);
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+		cJSON_AddNumberToObject(monitor,"upload_pending",manifest_count());
+#endif
+#ifdef CONFIG_GNSSR_SNR_ARCS
+		dev_status.snr_arcs=gnss_get_arcs_completed();
+		dev_status.snr_epochs_dropped=gnss_get_snr_dropped();
+		cJSON_AddNumberToObject(monitor,"snr_arcs",dev_status.snr_arcs);
+		cJSON_AddNumberToObject(monitor,"snr_epochs_dropped",dev_status.snr_epochs_dropped);
+#endif
+
+
+		/* losses along the way from the modem to the log */
+		struct pipeline_counters cnt;
+		pipeline_snapshot(&cnt);
+		cJSON * pipe=cJSON_AddObjectToObject(monitor,"pipeline");
+		cJSON_AddNumberToObject(pipe,"received",cnt.received);
+		cJSON_AddNumberToObject(pipe,"queued",cnt.queued);
+		cJSON * dropped=cJSON_AddObjectToObject(pipe,"dropped");
+		cJSON_AddNumberToObject(dropped,"read",cnt.dropped_read);
+		cJSON_AddNumberToObject(dropped,"corrupt",cnt.dropped_corrupt);
+		cJSON_AddNumberToObject(dropped,"encode",cnt.dropped_encode);
+		cJSON_AddNumberToObject(dropped,"ring_full",cnt.dropped_ring);
+		cJSON_AddNumberToObject(dropped,"no_fix",cnt.dropped_nofix);
+		cJSON_AddNumberToObject(dropped,"filter",cnt.dropped_filter);
+		cJSON_AddNumberToObject(pipe,"written",cnt.written);
+		cJSON_AddNumberToObject(pipe,"bytes_written",cnt.bytes_written);
+		cJSON_AddNumberToObject(pipe,"bytes_compressed",cnt.bytes_compressed);
+		cJSON_AddNumberToObject(pipe,"syncs",cnt.syncs);
+		cJSON_AddNumberToObject(pipe,"writer_waits",cnt.writer_waits);
+		cJSON_AddNumberToObject(pipe,"deadline_missed",cnt.deadline_missed);
+		cJSON_AddNumberToObject(pipe,"window_blocked",cnt.window_blocked);
+#ifdef CONFIG_GNSSR_RAWLOG
+		if (rawlog_mounted()){
+			struct rawlog_status raw;
+			rawlog_get_status(&raw);
+			cJSON * rawobj=cJSON_AddObjectToObject(monitor,"rawlog");
+			cJSON_AddNumberToObject(rawobj,"sectors",raw.nsectors);
+			cJSON_AddNumberToObject(rawobj,"next",raw.next);
+			cJSON_AddNumberToObject(rawobj,"writes",raw.nwrites);
+		}
+#endif
 
 		/*[> print json to string <]*/
 		int retcode= cJSON_PrintPreallocated(monitor,jsonbuffer,buflen,1);
@@ -265,12 +436,23 @@ int get_jsonstatus(char *jsonbuffer, int buflen){
 
 
 
+/* most recent battery voltage measurement (9999 when unknown) */
+uint16_t get_battery_mvolt(void){
+	if (hrprev >= 24){
+		return 9999;
+	}
+	return dev_status.battery_mvolt[hrprev];
+}
+
 int init_device_status(){
 		LOG_INF("Initializing device status");
 		strcpy(dev_status.device_id,confdata.filebase);
 		dev_status.longitude=0.0;
 		dev_status.altitude=0.0;
 		dev_status.latitude=0.0;
+		dev_status.gnss_ring_peak=0;
+		dev_status.snr_arcs=0;
+		dev_status.snr_epochs_dropped=0;
 
 		for(int i=0; i< 24;i++){
 			dev_status.battery_mvolt[i]=9999;
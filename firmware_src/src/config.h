@@ -1,5 +1,8 @@
 
 #include <nrf_modem_gnss.h>
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+#include "nmea_filter.h"
+#endif
 
 
 
@@ -7,6 +10,11 @@
 
 #define CONF_ERR 1
 
+/* data written to the GNSS log */
+#define LOG_MODE_NMEA 0 /* GSV and RMC sentences */
+#define LOG_MODE_PVT 1 /* binary PVT records (see pvtrecord.h) */
+#define LOG_MODE_ARCS 2 /* only the SNR arcs (see snrarc.h) */
+
 #ifndef CONFIG_H
 #define CONFIG_H
 
@@ -30,6 +38,14 @@ struct config {
 	int upload;
 	int psm_mode;
 	int pvt_low;
+	int sync_mode; /* sync policy of the log files (see lz4file.h) */
+	int sync_value; /* bytes or seconds between syncs, depending on sync_mode */
+	int index_interval; /* seconds between entries in the log index (0 disables the index) */
+	int prealloc_kb; /* KiB allocated up front for each GNSS data log (0: grow while writing) */
+	int log_mode; /* LOG_MODE_NMEA, LOG_MODE_PVT or LOG_MODE_ARCS */
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+	struct nmea_filter_config nmea_filter;
+#endif
 #ifdef CONFIG_UPLOAD_CLIENT
 	struct webdav_config webdav;
 #endif
@@ -45,9 +61,13 @@ struct device_status {
 	float latitude;
 	float altitude;
 	uint16_t battery_mvolt[24];
+	uint32_t gnss_ring_peak; /* highest fill level of the GNSS data buffer [bytes] */
+	uint32_t snr_arcs; /* SNR arcs completed since boot */
+	uint32_t snr_epochs_dropped; /* PVT solutions missed by the SNR arcs since their buffer was full */
 };
 
 int get_jsonstatus(char *jsonbuffer, int buflen);
+uint16_t get_battery_mvolt(void);
 
 int init_device_status();
 int update_device_status(const struct nrf_modem_gnss_pvt_data_frame * pvt);
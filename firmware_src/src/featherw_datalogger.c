@@ -13,6 +13,7 @@ refactored and modified from the fat_fs zephyr example by Tavish Naruka <tavishn
 
 #include "featherw_datalogger.h"
 #include <zephyr/types.h>
+#include <zephyr/sys/util.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(GNSSR,CONFIG_GNSSR_LOG_LEVEL);
@@ -160,39 +161,96 @@ bool file_exists(const char * path){
 
 }
 
-/*Reads a new line from a file*/
-ssize_t fs_gets(char * linebuffer,size_t bufsz,struct fs_file_t* fid){
-	ssize_t nread=fs_read(fid,linebuffer,bufsz);
-	if(nread < bufsz && nread >0){
-		linebuffer[nread]='\0';
-		return nread;
-	}else if (nread == bufsz){
-		/*Possibly more has been read than necessary: Find the line end*/
-		char * lnend;
-		if ((lnend=strchr(linebuffer,'\n')) == NULL){
-			/*if((lnend=strchr(linebuffer,'\r')) == NULL){*/
-				lnend=linebuffer+bufsz-1;
-			/*}*/
+/* Start reading a file (opened for reading) through the buffer buf of size bytes */
+void fs_reader_init(struct fs_reader * rd, struct fs_file_t * fid, char * buf, size_t size){
+	rd->fid=fid;
+	rd->buf=buf;
+	rd->size=size;
+	rd->pos=0;
+	rd->len=0;
+	rd->eof=false;
+}
+
+/* read the next part of the file into the (consumed) buffer */
+static int fs_reader_fill(struct fs_reader * rd){
+	if (rd->pos < rd->len || rd->eof){
+		return FEA_SUCCESS;
+	}
+	ssize_t nread=fs_read(rd->fid,rd->buf,rd->size);
+	if (nread < 0){
+		return FEA_ERR_READ;
+	}
+	rd->pos=0;
+	rd->len=nread;
+	rd->eof=(nread == 0);
+	return FEA_SUCCESS;
+}
+
+/* Reads the next line, including its line end, as a NUL terminated string (like fgets). A line which
+ * does not fit in linesz-1 bytes is returned in pieces. Returns the length, 0 at the end of the
+ * file or FEA_ERR_READ */
+ssize_t fs_reader_gets(struct fs_reader * rd, char * line, size_t linesz){
+	size_t n=0;
+	while (n+1 < linesz){
+		if (fs_reader_fill(rd) != FEA_SUCCESS){
+			return FEA_ERR_READ;
+		}
+		if (rd->eof){
+			break;
+		}
+		size_t ncopy=MIN(rd->len-rd->pos,linesz-1-n);
+		const char * lnend=memchr(rd->buf+rd->pos,'\n',ncopy);
+		if (lnend != NULL){
+			ncopy=lnend-(rd->buf+rd->pos)+1;
+		}
+		memcpy(line+n,rd->buf+rd->pos,ncopy);
+		rd->pos+=ncopy;
+		n+=ncopy;
+		if (lnend != NULL){
+			break;
 		}
-		ptrdiff_t slen=lnend-linebuffer+1;
-		/*printk("slen %d\n",(int)slen);*/
-		if (slen < bufsz){
-			linebuffer[slen]='\0';
-				off_t offs=bufsz-slen;
-				/*LOG_INF("nread %d, seeking backwards with %d\n",(int)nread,(int)offs);*/
-			if (fs_seek(fid,-offs,FS_SEEK_CUR) < 0){
-				return -2;
+	}
+	if (linesz > 0){
+		line[n]='\0';
+	}
+	return n;
+}
+
+/* Reads up to n bytes, less only at the end of the file. Returns the number of bytes read or FEA_ERR_READ */
+ssize_t fs_reader_read(struct fs_reader * rd, void * dst, size_t n){
+	char * out=dst;
+	size_t nout=0;
+	while (nout < n){
+		if (rd->pos == rd->len && n-nout >= rd->size && !rd->eof){
+			/* large reads bypass the buffer */
+			ssize_t nread=fs_read(rd->fid,out+nout,n-nout);
+			if (nread < 0){
+				return FEA_ERR_READ;
 			}
-			return slen;
-		}else{
-			/*LOG_INF("returning full buffer\n");*/
-			return bufsz;
+			rd->eof=(nread == 0);
+			nout+=nread;
+			if (rd->eof){
+				break;
+			}
+			continue;
 		}
-	}else{
-		/*Errors and EOF's*/
-		return -1;
+		if (fs_reader_fill(rd) != FEA_SUCCESS){
+			return FEA_ERR_READ;
+		}
+		if (rd->eof){
+			break;
+		}
+		size_t ncopy=MIN(rd->len-rd->pos,n-nout);
+		memcpy(out+nout,rd->buf+rd->pos,ncopy);
+		rd->pos+=ncopy;
+		nout+=ncopy;
 	}
-	
+	return nout;
+}
+
+/* true when all of the file has been read (or it cannot be read any further) */
+bool fs_reader_eof(struct fs_reader * rd){
+	return fs_reader_fill(rd) != FEA_SUCCESS || rd->eof;
 }
 
 
@@ -214,7 +272,7 @@ int lsdir_close(struct fs_dir_t * dirp){
 	return fs_closedir(dirp);
 }
 
-int lsdir_next(const char * endswith, struct fs_dir_t * dirp, char * path){
+int lsdir_next(const char * endswith, struct fs_dir_t * dirp, char * path, size_t size){
 
 	static struct fs_dirent entry;
 	int res;
@@ -234,15 +292,20 @@ int lsdir_next(const char * endswith, struct fs_dir_t * dirp, char * path){
 			/* apply filter criteria to a file*/
 			if (endswith != NULL){
 				/* check filename with filter*/
-				int ncmp=strlen(endswith);
-				if(strcmp(entry.name+strlen(entry.name)-ncmp,endswith) != 0){
+				size_t ncmp=strlen(endswith);
+				size_t nlen=strlen(entry.name);
+				if(nlen < ncmp || strcmp(entry.name+nlen-ncmp,endswith) != 0){
 					/*no match keep going */
 					continue;
 				}
 			} 
 			
 			/* construct output path filename*/
-			strcpy(path,entry.name);
+			if (strlen(entry.name) >= size){
+				LOG_WRN("Skipping %s, the name is too long",entry.name);
+				continue;
+			}
+			strncpy(path,entry.name,size);
 			return 0;/*success*/
 		}
 	}
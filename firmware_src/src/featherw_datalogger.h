@@ -26,6 +26,19 @@
 #define FEA_ERR_SECCOUNT -2
 #define FEA_ERR_SECSIZE -3
 #define FEA_ERR_MOUNT -4
+#define FEA_ERR_READ -5
+
+/*
+ * Buffered reading of a file in one forward pass, e.g. line by line
+ */
+struct fs_reader {
+	struct fs_file_t * fid;
+	char * buf;
+	size_t size;
+	size_t pos; /* next unread byte in buf */
+	size_t len; /* bytes in buf */
+	bool eof;
+};
 
 
 /*
@@ -39,7 +52,10 @@ int initialize_sdcard_files(void);
 int get_sd_data_path(char * outpath, const char * filename);
 int get_sd_config_path(char * outpath, const char * filename);
 
-ssize_t fs_gets(char * linebuffer,size_t bufsz,struct fs_file_t* fid);
+void fs_reader_init(struct fs_reader * rd, struct fs_file_t * fid, char * buf, size_t size);
+ssize_t fs_reader_gets(struct fs_reader * rd, char * line, size_t linesz);
+ssize_t fs_reader_read(struct fs_reader * rd, void * dst, size_t n);
+bool fs_reader_eof(struct fs_reader * rd);
 
 bool file_exists(const char *path);
 
@@ -47,5 +63,5 @@ size_t file_size(const char *path);
 
 int lsdir_init(const char* dirpath, struct fs_dir_t *dirp);
 int lsdir_close(struct fs_dir_t * dirp);
-int lsdir_next(const char * endswith, struct fs_dir_t *dirp, char* path);
+int lsdir_next(const char * endswith, struct fs_dir_t *dirp, char* path, size_t size);
 #endif /* FEATHERW_H */
@@ -9,8 +9,17 @@
 #include <zephyr/kernel.h>
 #include "modem.h"
 #include "config.h"
+#include "gnss.h"
+#include "spscring.h"
+#include "pvtrecord.h"
+#include "nmea_parse.h"
+#include "pipeline.h"
+#ifdef CONFIG_GNSSR_SNR_ARCS
+#include "snrarc.h"
+#endif
 #include <nrf_modem_gnss.h>
 #include <stdio.h>
+#include <string.h>
 #include <zephyr/logging/log.h>
 #if defined(CONFIG_SUPL_CLIENT_LIB)
 #include "supl_support.h"
@@ -25,18 +34,65 @@ static struct nrf_modem_gnss_pvt_data_frame pvt_data;
 static uint8_t last_day=0;
 static uint64_t fix_timestamp;
 static int agps=0;
+static struct nrf_modem_gnss_nmea_data_frame nmea_frame;
+static uint8_t pvt_record[PVTREC_MAXSIZE];
 #if defined(CONFIG_SUPL_CLIENT_LIB)
 static struct nrf_modem_gnss_agps_data_frame last_agps;
 #endif
 
 extern struct config confdata;
 extern struct k_sem rollover_event_sem;
-K_MSGQ_DEFINE(nmea_queue, sizeof(struct nrf_modem_gnss_nmea_data_frame *), 10, 4);
+/* NMEA sentences or PVT records (depending on the log mode) waiting to be written (filled by the
+ * event handler, emptied by the main loop) */
+SPSCRING_DEFINE(gnss_ring, CONFIG_GNSSR_RING_SIZE);
+
+#ifdef CONFIG_GNSSR_SNR_ARCS
+static struct snrarc_builder arc_builder;
+static struct snrarc_epoch snr_epoch;
+/* satellites of the PVT solutions waiting to be added to the SNR arcs (filled by the event handler,
+ * emptied by the main loop) */
+SPSCRING_DEFINE(snr_ring, CONFIG_GNSSR_ARC_RING_SIZE);
+BUILD_ASSERT(CONFIG_GNSSR_ARC_RING_SIZE >= SNRARC_EPOCH_SIZE(NRF_MODEM_GNSS_MAX_SATELLITES)+SPSCRING_HDRSIZE,
+	"GNSSR_ARC_RING_SIZE cannot hold an epoch");
+#endif
 
 uint32_t got_fix(void){
 	return gnss_fixed;
 }
 
+/* highest fill level of the ring [bytes] since boot */
+uint32_t gnss_get_ring_peak(void){
+	return gnss_ring.peak;
+}
+
+#ifdef CONFIG_GNSSR_SNR_ARCS
+/* number of SNR arcs which were completed since boot */
+uint32_t gnss_get_arcs_completed(void){
+	return arc_builder.ncompleted;
+}
+
+/* number of epochs which were missed by the SNR arcs since their ring was full */
+uint32_t gnss_get_snr_dropped(void){
+	return snr_ring.dropped;
+}
+
+/* set the function which receives the completed SNR arcs (before init_gnss) */
+void gnss_init_arcs(snrarc_complete_t complete, void * ctx){
+	snrarc_init(&arc_builder,complete,ctx);
+}
+
+/* Add the oldest queued epoch to the SNR arcs (in the main loop rather than in the event handler,
+ * since completing an arc copies it). Returns the size of the epoch, or <= 0 when none was queued */
+int gnss_update_arcs(void){
+	static struct snrarc_epoch epoch;
+	int nepoch=spscring_get(&snr_ring,&epoch,sizeof(epoch));
+	if (nepoch >= (int)SNRARC_EPOCH_SIZE(0) && nepoch == (int)SNRARC_EPOCH_SIZE(epoch.nsv)){
+		snrarc_update(&arc_builder,&epoch);
+	}
+	return nepoch;
+}
+#endif
+
 void print_housekeeping_data(struct nrf_modem_gnss_pvt_data_frame *pvt_ptr)
 {
 	
@@ -104,11 +160,20 @@ void print_searching(struct nrf_modem_gnss_pvt_data_frame *pvt_ptr)
 static void gnss_event_handler(int event)
 {
 	int retval;
-	struct nrf_modem_gnss_nmea_data_frame *nmea_data;
 
 	switch (event) {
 	case NRF_MODEM_GNSS_EVT_PVT:
 		retval = nrf_modem_gnss_read(&pvt_data, sizeof(pvt_data), NRF_MODEM_GNSS_DATA_PVT);
+		if (retval != 0) {
+			pipeline.dropped_read++;
+			break;
+		}
+		if (pvt_data.flags & NRF_MODEM_GNSS_PVT_FLAG_DEADLINE_MISSED) {
+			pipeline.deadline_missed++;
+		}
+		if (pvt_data.flags & NRF_MODEM_GNSS_PVT_FLAG_NOT_ENOUGH_WINDOW_TIME) {
+			pipeline.window_blocked++;
+		}
 		/*check whether the PVT is from a fixed event*/
 
 		if(pvt_data.flags & NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID){
@@ -136,27 +201,55 @@ static void gnss_event_handler(int event)
 			last_day=pvt_data.datetime.day;
 		}
 
+		/* queue the solution and satellites in binary form */
+		if (confdata.log_mode == LOG_MODE_PVT && gnss_fixed > 0){
+			size_t nrec=pvtrec_encode(&pvt_data,gnss_get_unixtime(),pvt_record,sizeof(pvt_record));
+			pipeline.received++;
+			if (nrec == 0){
+				pipeline.dropped_encode++;
+			}else if (spscring_put(&gnss_ring,pvt_record,nrec) != 0){
+				pipeline.dropped_ring++;
+			}else{
+				pipeline.queued++;
+			}
+		}
+
+#ifdef CONFIG_GNSSR_SNR_ARCS
+		if (gnss_fixed > 0){
+			size_t nepoch=snrarc_pack(&pvt_data,gnss_get_unixtime(),&snr_epoch);
+			spscring_put(&snr_ring,&snr_epoch,nepoch);
+		}
+#endif
+
 		
 		break;
 
-	case NRF_MODEM_GNSS_EVT_NMEA:
-		nmea_data = k_malloc(sizeof(struct nrf_modem_gnss_nmea_data_frame));
-		if (nmea_data == NULL) {
-			LOG_ERR("Failed to allocate memory for NMEA");
+	case NRF_MODEM_GNSS_EVT_NMEA: {
+		retval = nrf_modem_gnss_read(&nmea_frame,
+					     sizeof(nmea_frame),
+					     NRF_MODEM_GNSS_DATA_NMEA);
+		if (retval != 0) {
+			pipeline.dropped_read++;
 			break;
 		}
+		pipeline.received++;
 
-		retval = nrf_modem_gnss_read(nmea_data,
-					     sizeof(struct nrf_modem_gnss_nmea_data_frame),
-					     NRF_MODEM_GNSS_DATA_NMEA);
-		if (retval == 0) {
-			retval = k_msgq_put(&nmea_queue, &nmea_data, K_NO_WAIT);
-		}
+		struct nmea_sentence snt;
+		size_t len = strnlen(nmea_frame.nmea_str, NRF_MODEM_GNSS_NMEA_MAX_LEN);
 
-		if (retval != 0) {
-			k_free(nmea_data);
+		/* corrupt sentences are not worth compressing: count and drop them */
+		if (nmea_parse(nmea_frame.nmea_str, len, &snt) != NMEA_SUCCESS) {
+			pipeline.dropped_corrupt++;
+			break;
+		}
+		/* only the sentence itself is stored, not the whole frame */
+		if (spscring_put(&gnss_ring, nmea_frame.nmea_str, len) != 0) {
+			pipeline.dropped_ring++;
+		} else {
+			pipeline.queued++;
 		}
 		break;
+	}
 #if defined(CONFIG_SUPL_CLIENT_LIB)
 	case NRF_MODEM_GNSS_EVT_AGPS_REQ:
 		if(agps == 0)
@@ -214,6 +307,23 @@ void gnss_get_current_datetimestr(char cptr[]){
 
 }
 
+/* seconds since 1970-01-01 of the last PVT solution */
+uint32_t gnss_get_unixtime(void){
+	/* days since the epoch from the civil date (proleptic Gregorian calendar) */
+	int32_t year=pvt_data.datetime.year;
+	uint32_t month=pvt_data.datetime.month;
+	if (month <= 2){
+		year-=1;
+	}
+	int32_t era=year/400;
+	uint32_t yoe=(uint32_t)(year-era*400);
+	uint32_t doy=(153*(month > 2 ? month-3 : month+9)+2)/5+pvt_data.datetime.day-1;
+	uint32_t doe=yoe*365+yoe/4-yoe/100+doy;
+	int32_t days=era*146097+(int32_t)doe-719468;
+
+	return (uint32_t)days*86400U+pvt_data.datetime.hour*3600U+pvt_data.datetime.minute*60U+pvt_data.datetime.seconds;
+}
+
 /* init and start gnss*/
 int init_gnss(int useagps)
 {
@@ -252,6 +362,17 @@ int init_gnss(int useagps)
 
 	uint16_t nmea_mask    = NRF_MODEM_GNSS_NMEA_GSV_MASK |
 				NRF_MODEM_GNSS_NMEA_RMC_MASK ;
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+	/* sentence types which are filtered out anyway don't need to be formatted by the modem */
+	BUILD_ASSERT(NMEA_SENTENCE_GGA == NRF_MODEM_GNSS_NMEA_GGA_MASK && NMEA_SENTENCE_GLL == NRF_MODEM_GNSS_NMEA_GLL_MASK &&
+		     NMEA_SENTENCE_GSA == NRF_MODEM_GNSS_NMEA_GSA_MASK && NMEA_SENTENCE_GSV == NRF_MODEM_GNSS_NMEA_GSV_MASK &&
+		     NMEA_SENTENCE_RMC == NRF_MODEM_GNSS_NMEA_RMC_MASK, "NMEA sentence bits differ from the modem mask");
+	nmea_mask = confdata.nmea_filter.sentences;
+#endif
+	if (confdata.log_mode != LOG_MODE_NMEA){
+		/* the PVT frames carry all logged data, so the modem doesn't need to format NMEA */
+		nmea_mask = 0;
+	}
 
 	
 	retval=nrf_modem_gnss_nmea_mask_set(nmea_mask);
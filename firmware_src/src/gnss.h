@@ -6,10 +6,21 @@
 */
 
 #include <stdint.h>
+#ifdef CONFIG_GNSSR_SNR_ARCS
+#include "snrarc.h"
+#endif
 
 uint32_t got_fix(void);
 
 void gnss_get_current_datetimestr(char cptr[]);
+uint32_t gnss_get_unixtime(void);
+uint32_t gnss_get_ring_peak(void);
+#ifdef CONFIG_GNSSR_SNR_ARCS
+uint32_t gnss_get_arcs_completed(void);
+uint32_t gnss_get_snr_dropped(void);
+void gnss_init_arcs(snrarc_complete_t complete, void * ctx);
+int gnss_update_arcs(void);
+#endif
 
 int32_t init_gnss(int useagps);
 int32_t start_gnss(void);
@@ -0,0 +1,375 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Simulated GNSS of the modem for native_sim (CONFIG_GNSSR_GNSS_SIM), standing in for the
+ * nrf_modem_gnss functions and the modem setup of modem.c. It replays a recorded NMEA trace
+ * (plain text, as decompressed from the logs) into the GNSS event handler of gnss.c, so the
+ * whole logging pipeline can be loaded on a development machine:
+ *   build/zephyr/zephyr.exe --gnss-trace=recorded.nmea --gnss-speed=100
+ * Every epoch ends with its RMC sentence. For each epoch a PVT frame is built from the RMC
+ * sentence and the satellites in the GSV sentences, and delivered (NRF_MODEM_GNSS_EVT_PVT)
+ * before the sentences of the epoch (NRF_MODEM_GNSS_EVT_NMEA), as the modem does. The epochs
+ * follow each other at the recorded times divided by the speed; a speed of 0 replays as fast as
+ * possible. The events come from a cooperative thread rather than an interrupt.
+ */
+
+#include <zephyr/kernel.h>
+#include <nrf_modem_gnss.h>
+#include <string.h>
+#include <errno.h>
+#include <nsi_host_trampolines.h>
+#include "cmdline.h"
+#include "soc.h"
+#include "nmea_parse.h"
+#include "modem.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(GNSSR,CONFIG_GNSSR_LOG_LEVEL);
+
+#define SIM_STACK_SIZE 2048
+#define SIM_PRIORITY K_PRIO_COOP(2)
+/* sentences of one epoch */
+#define SIM_MAX_SENTENCES 32
+/* longest pause between two epochs [ms] (e.g. gaps in the trace) */
+#define SIM_MAX_GAP 10000
+
+static char * trace_path;
+static int32_t speed=CONFIG_GNSSR_GNSS_SIM_SPEED;
+static bool loop;
+
+static nrf_modem_gnss_event_handler_type_t event_handler;
+static uint16_t nmea_mask;
+static uint8_t min_elevation;
+static bool running;
+
+static struct nrf_modem_gnss_pvt_data_frame pvt_frame;
+static struct nrf_modem_gnss_nmea_data_frame nmea_frame;
+
+struct sim_epoch {
+	char sentences[SIM_MAX_SENTENCES][NRF_MODEM_GNSS_NMEA_MAX_LEN];
+	uint16_t masks[SIM_MAX_SENTENCES];
+	int nsentences;
+	struct nrf_modem_gnss_pvt_data_frame pvt;
+	int nsv;
+	int64_t time; /* ms since 1970 */
+};
+
+static struct sim_epoch epoch;
+
+/* buffered line reader of the trace on the host */
+static struct {
+	int fd;
+	char buf[4096];
+	int pos;
+	int len;
+} trace={.fd=-1};
+
+K_THREAD_STACK_DEFINE(sim_stack, SIM_STACK_SIZE);
+static struct k_thread sim_thread;
+
+static void add_options(void){
+	static struct args_struct_t sim_options[]={
+		{.option="gnss-trace",.name="path",.type='s',.dest=(void *)&trace_path,
+			.descript="NMEA trace to replay as the GNSS of the modem"},
+		{.option="gnss-speed",.name="factor",.type='i',.dest=(void *)&speed,
+			.descript="replay speed relative to the recorded time (0: as fast as possible)"},
+		{.is_switch=true,.option="gnss-loop",.type='b',.dest=(void *)&loop,
+			.descript="restart the trace when it ends"},
+		ARG_TABLE_ENDMARKER
+	};
+	native_add_command_line_opts(sim_options);
+}
+
+NATIVE_TASK(add_options, PRE_BOOT_1, 10);
+
+/* read a line (without its line end), returns its length or -1 at the end of the trace */
+static int trace_getline(char * line, int maxlen){
+	int n=0;
+	for (;;){
+		if (trace.pos == trace.len){
+			trace.len=nsi_host_read(trace.fd,trace.buf,sizeof(trace.buf));
+			trace.pos=0;
+			if (trace.len <= 0){
+				trace.len=0;
+				if (n == 0){
+					return -1;
+				}
+				break;
+			}
+		}
+		char c=trace.buf[trace.pos++];
+		if (c == '\n'){
+			break;
+		}
+		/* longer lines are cut, and fail the checksum */
+		if (c != '\r' && n < maxlen-1){
+			line[n++]=c;
+		}
+	}
+	line[n]='\0';
+	return n;
+}
+
+static int trace_open(void){
+	if (trace.fd >= 0){
+		nsi_host_close(trace.fd);
+	}
+	trace.pos=0;
+	trace.len=0;
+	/* O_RDONLY of the host */
+	trace.fd=nsi_host_open(trace_path,0);
+	return trace.fd;
+}
+
+/* days since 1970 of a date in the proleptic Gregorian calendar */
+static int64_t days_from_civil(int y, int m, int d){
+	y-=(m <= 2);
+	int64_t era=(y >= 0 ? y : y-399)/400;
+	int64_t yoe=y-era*400;
+	int64_t doy=(153*(m+(m > 2 ? -3 : 9))+2)/5+d-1;
+	int64_t doe=yoe*365+yoe/4-yoe/100+doy;
+	return era*146097+doe-719468;
+}
+
+static uint16_t sentence_mask(const char * addr, size_t len){
+	static const struct {
+		char formatter[3];
+		uint16_t mask;
+	} masks[]={
+		{{'G','G','A'},NRF_MODEM_GNSS_NMEA_GGA_MASK},
+		{{'G','L','L'},NRF_MODEM_GNSS_NMEA_GLL_MASK},
+		{{'G','S','A'},NRF_MODEM_GNSS_NMEA_GSA_MASK},
+		{{'G','S','V'},NRF_MODEM_GNSS_NMEA_GSV_MASK},
+		{{'R','M','C'},NRF_MODEM_GNSS_NMEA_RMC_MASK},
+	};
+	for (size_t i=0;len == 5 && i<ARRAY_SIZE(masks);i++){
+		if (memcmp(addr+2,masks[i].formatter,3) == 0){
+			return masks[i].mask;
+		}
+	}
+	return 0;
+}
+
+static void add_satellites(struct sim_epoch * ep, const struct nmea_gsv * gsv){
+	for (int i=0;i<gsv->nentries && ep->nsv < NRF_MODEM_GNSS_MAX_SATELLITES;i++){
+		const struct nmea_gsv_sat * sat=&gsv->sats[i];
+		/* the modem reports at most 12 satellites, of which it tracks a signal */
+		if (sat->snr < 0 || sat->elevation < min_elevation){
+			continue;
+		}
+		struct nrf_modem_gnss_sv * sv=&ep->pvt.sv[ep->nsv++];
+		sv->sv=sat->prn;
+		sv->signal=NRF_MODEM_GNSS_SV_TYPE_GPSL1CA;
+		sv->cn0=sat->snr*10;
+		sv->elevation=sat->elevation;
+		sv->azimuth=MAX(sat->azimuth,0);
+		sv->flags=NRF_MODEM_GNSS_SV_FLAG_USED_IN_FIX;
+	}
+}
+
+static void set_solution(struct nrf_modem_gnss_pvt_data_frame * pvt, const struct nmea_rmc * rmc){
+	pvt->latitude=rmc->latitude*1e-7;
+	pvt->longitude=rmc->longitude*1e-7;
+	pvt->accuracy=rmc->valid ? 10.0f : 0.0f;
+	pvt->datetime.year=2000+rmc->year;
+	pvt->datetime.month=rmc->month;
+	pvt->datetime.day=rmc->day;
+	pvt->datetime.hour=rmc->time/3600000;
+	pvt->datetime.minute=(rmc->time/60000)%60;
+	pvt->datetime.seconds=(rmc->time/1000)%60;
+	pvt->datetime.ms=rmc->time%1000;
+	pvt->flags=rmc->valid ? NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID : 0;
+}
+
+/* read the sentences up to and including the next RMC sentence, returns false at the end of the trace */
+static bool read_epoch(struct sim_epoch * ep){
+	struct nmea_sentence snt;
+	struct nmea_data data;
+	char line[NRF_MODEM_GNSS_NMEA_MAX_LEN+2];
+	int len;
+
+	memset(&ep->pvt,0,sizeof(ep->pvt));
+	ep->nsentences=0;
+	ep->nsv=0;
+	while ((len=trace_getline(line,sizeof(line)-2)) >= 0){
+		/* keep corrupt sentences, the application has to cope with them */
+		bool valid=(nmea_parse(line,len,&snt) == NMEA_SUCCESS);
+		if (ep->nsentences < SIM_MAX_SENTENCES && len > 0){
+			/* the modem terminates its sentences with CR LF */
+			memcpy(line+len,"\r\n",2);
+			len=MIN(len+2,NRF_MODEM_GNSS_NMEA_MAX_LEN-1);
+			memcpy(ep->sentences[ep->nsentences],line,len);
+			ep->sentences[ep->nsentences][len]='\0';
+			ep->masks[ep->nsentences++]=valid ? sentence_mask(line+1,snt.fields[0].len) : NRF_MODEM_GNSS_NMEA_GSV_MASK;
+		}
+		if (!valid || nmea_decode(&snt,&data) != NMEA_SUCCESS){
+			continue;
+		}
+		if (data.type == NMEA_TYPE_GSV){
+			add_satellites(ep,&data.gsv);
+		}else if (data.type == NMEA_TYPE_RMC){
+			set_solution(&ep->pvt,&data.rmc);
+			ep->time=days_from_civil(2000+data.rmc.year,data.rmc.month,data.rmc.day)*86400000LL+data.rmc.time;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void deliver_epoch(const struct sim_epoch * ep){
+	memcpy(&pvt_frame,&ep->pvt,sizeof(pvt_frame));
+	event_handler(NRF_MODEM_GNSS_EVT_PVT);
+	for (int i=0;i<ep->nsentences;i++){
+		if ((ep->masks[i] & nmea_mask) == 0){
+			continue;
+		}
+		memcpy(nmea_frame.nmea_str,ep->sentences[i],sizeof(nmea_frame.nmea_str));
+		event_handler(NRF_MODEM_GNSS_EVT_NMEA);
+	}
+}
+
+static void replay(void * p1, void * p2, void * p3){
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+	uint32_t nepochs=0;
+	uint32_t nsentences=0;
+	int64_t start=k_uptime_get();
+	int64_t deadline=start;
+	int64_t prev=-1;
+
+	LOG_INF("Replaying GNSS trace %s at %dx",trace_path,speed);
+	while (running){
+		if (!read_epoch(&epoch)){
+			if (!loop || nepochs == 0 || trace_open() < 0){
+				break;
+			}
+			prev=-1;
+			continue;
+		}
+		if (prev >= 0 && speed > 0){
+			deadline+=CLAMP(epoch.time-prev,0,SIM_MAX_GAP)/speed;
+			k_sleep(K_TIMEOUT_ABS_MS(deadline));
+		}
+		prev=epoch.time;
+		deliver_epoch(&epoch);
+		nepochs++;
+		nsentences+=epoch.nsentences;
+		if (speed == 0){
+			/* let the logger run, as it would between the interrupts of the modem */
+			k_yield();
+		}
+	}
+	int64_t elapsed=MAX(k_uptime_get()-start,1);
+	LOG_INF("GNSS trace done: %u epochs and %u sentences in %lld ms (%u sentences/s)",nepochs,nsentences,
+			elapsed,(uint32_t)(nsentences*1000LL/elapsed));
+	running=false;
+}
+
+int32_t nrf_modem_gnss_event_handler_set(nrf_modem_gnss_event_handler_type_t handler){
+	event_handler=handler;
+	return 0;
+}
+
+int32_t nrf_modem_gnss_start(void){
+	if (event_handler == NULL || trace_path == NULL){
+		LOG_ERR("No GNSS trace given (--gnss-trace)");
+		return -EINVAL;
+	}
+	if (running){
+		return 0;
+	}
+	if (trace_open() < 0){
+		LOG_ERR("Cannot open GNSS trace %s",trace_path);
+		return -ENOENT;
+	}
+	speed=CLAMP(speed,0,100);
+	running=true;
+	k_thread_create(&sim_thread,sim_stack,K_THREAD_STACK_SIZEOF(sim_stack),replay,NULL,NULL,NULL,
+			SIM_PRIORITY,0,K_NO_WAIT);
+	k_thread_name_set(&sim_thread,"gnss_sim");
+	return 0;
+}
+
+int32_t nrf_modem_gnss_stop(void){
+	if (running){
+		running=false;
+		k_thread_join(&sim_thread,K_FOREVER);
+	}
+	return 0;
+}
+
+int32_t nrf_modem_gnss_read(void * buf, int32_t buf_len, int type){
+	switch (type){
+		case NRF_MODEM_GNSS_DATA_PVT:
+			if (buf_len < (int32_t)sizeof(pvt_frame)){
+				return -EINVAL;
+			}
+			memcpy(buf,&pvt_frame,sizeof(pvt_frame));
+			return 0;
+		case NRF_MODEM_GNSS_DATA_NMEA:
+			if (buf_len < (int32_t)sizeof(nmea_frame)){
+				return -EINVAL;
+			}
+			memcpy(buf,&nmea_frame,sizeof(nmea_frame));
+			return 0;
+		default:
+			return -EINVAL;
+	}
+}
+
+int32_t nrf_modem_gnss_nmea_mask_set(uint16_t mask){
+	nmea_mask=mask;
+	return 0;
+}
+
+int32_t nrf_modem_gnss_elevation_threshold_set(uint8_t angle){
+	min_elevation=angle;
+	return 0;
+}
+
+/* settings which don't change the replay */
+int32_t nrf_modem_gnss_fix_interval_set(uint16_t fix_interval){
+	return 0;
+}
+
+int32_t nrf_modem_gnss_fix_retry_set(uint16_t fix_retry){
+	return 0;
+}
+
+int32_t nrf_modem_gnss_use_case_set(uint8_t use_case){
+	return 0;
+}
+
+int32_t nrf_modem_gnss_power_mode_set(uint8_t mode){
+	return 0;
+}
+
+/* the modem functions of modem.h, there is no LTE in the simulation */
+int setup_modem(void){
+	return 0;
+}
+
+int lte_connect(void){
+	return -1;
+}
+
+void lte_disconnect(void){
+}
+
+int enable_gnss_mode(void){
+	return 0;
+}
+
+void print_boardinfo(){
+	LOG_INF("---begin board info---");
+#ifdef CONFIG_GNSSR_VERSION
+	LOG_INF("GNSS-R_version: %s",CONFIG_GNSSR_VERSION);
+#endif
+	LOG_INF("simulated GNSS, replaying %s",(trace_path != NULL) ? trace_path : "nothing");
+	LOG_INF("---end board info---");
+}
@@ -0,0 +1,219 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/byteorder.h>
+#include "snrarc.h"
+#include "gnssir.h"
+
+/* size of the sine table (one full turn) */
+#define SINTAB_BITS 10
+#define SINTAB_SIZE (1 << SINTAB_BITS)
+
+#define PI_F 3.14159265f
+
+/* smallest elevation range [deg] of an arc which resolves the reflector height */
+#define GNSSIR_MIN_ELEV_SPAN 5
+
+BUILD_ASSERT(CONFIG_GNSSR_GNSSIR_MIN_RH < CONFIG_GNSSR_GNSSIR_MAX_RH, "empty reflector height range");
+
+static int16_t sintab[SINTAB_SIZE]; /* Q15 */
+
+/* work arrays for one arc */
+static float xf[CONFIG_GNSSR_ARC_MAX_POINTS]; /* sin(elevation) */
+static float yf[CONFIG_GNSSR_ARC_MAX_POINTS]; /* linear SNR, later its residual */
+static uint16_t xq[CONFIG_GNSSR_ARC_MAX_POINTS]; /* sin(elevation), Q16 */
+static int16_t yq[CONFIG_GNSSR_ARC_MAX_POINTS]; /* detrended SNR, Q15 (scaled by its maximum) */
+
+void gnssir_init(void){
+	for (int i=0;i<SINTAB_SIZE;i++){
+		sintab[i]=(int16_t)lrintf(32767.0f*sinf(2.0f*PI_F*i/SINTAB_SIZE));
+	}
+}
+
+/* least squares fit of y=c[0]+c[1]*x+c[2]*x^2 (x is expected to be of order 1) */
+static int polyfit2(const float * x, const float * y, int n, float c[3]){
+	float a[3][4]={0};
+
+	for (int i=0;i<n;i++){
+		float p[3]={1.0f,x[i],x[i]*x[i]};
+		for (int r=0;r<3;r++){
+			for (int k=0;k<3;k++){
+				a[r][k]+=p[r]*p[k];
+			}
+			a[r][3]+=p[r]*y[i];
+		}
+	}
+	/* gaussian elimination (the normal matrix is symmetric positive definite) */
+	for (int r=0;r<3;r++){
+		if (fabsf(a[r][r]) < 1e-12f){
+			return GNSSIR_ERR_QUALITY;
+		}
+		for (int rr=r+1;rr<3;rr++){
+			float f=a[rr][r]/a[r][r];
+			for (int k=r;k<4;k++){
+				a[rr][k]-=f*a[r][k];
+			}
+		}
+	}
+	for (int r=2;r>=0;r--){
+		float sum=a[r][3];
+		for (int k=r+1;k<3;k++){
+			sum-=a[r][k]*c[k];
+		}
+		c[r]=sum/a[r][r];
+	}
+	return GNSSIR_SUCCESS;
+}
+
+/* amplitude of the least squares fit of a*cos+b*sin at a frequency of fq8/256 cycles per unit of sin(elevation) */
+static float ls_amplitude(int n, uint32_t fq8){
+	int64_t c=0;
+	int64_t s=0;
+	int64_t cc=0;
+	int64_t ss=0;
+	int64_t cs=0;
+
+	for (int i=0;i<n;i++){
+		/* the phase in turns (Q16) wraps around by itself */
+		uint16_t phase=(uint16_t)((fq8*xq[i]) >> 8);
+		int idx=phase >> (16-SINTAB_BITS);
+		int32_t sn=sintab[idx];
+		int32_t cn=sintab[(idx+SINTAB_SIZE/4) & (SINTAB_SIZE-1)];
+		c+=yq[i]*cn;
+		s+=yq[i]*sn;
+		cc+=cn*cn;
+		ss+=sn*sn;
+		cs+=cn*sn;
+	}
+	float fc=c;
+	float fs=s;
+	float fcc=cc;
+	float fss=ss;
+	float fcs=cs;
+	float det=fcc*fss-fcs*fcs;
+	if (det <= 0.0f){
+		return 0.0f;
+	}
+	float a=(fc*fss-fs*fcs)/det;
+	float b=(fs*fcc-fc*fcs)/det;
+	return sqrtf(a*a+b*b);
+}
+
+/* Estimate the reflector height from an arc record (as put in the arc ring). Takes of the order of
+ * a million multiply-accumulates, so it should run in a thread rather than in the GNSS event handler */
+int gnssir_retrieve(const uint8_t * arc, size_t narc, struct gnssir_result * res){
+	struct snrarc_header hdr;
+	struct snrarc_point pt;
+	float c[3];
+
+	if (narc < sizeof(hdr)){
+		return GNSSIR_ERR_ARC;
+	}
+	memcpy(&hdr,arc,sizeof(hdr));
+	int n=sys_le16_to_cpu(hdr.npoints);
+	if (hdr.sync[0] != SNRARC_SYNC0 || hdr.sync[1] != SNRARC_SYNC1 || hdr.version != SNRARC_VERSION ||
+			n < 3 || n > CONFIG_GNSSR_ARC_MAX_POINTS || narc != sizeof(hdr)+n*sizeof(pt)){
+		return GNSSIR_ERR_ARC;
+	}
+
+	/* the modem reports whole degrees: fit the elevation versus (normalized) time */
+	memcpy(&pt,arc+sizeof(hdr)+(n-1)*sizeof(pt),sizeof(pt));
+	float tspan=MAX(sys_le16_to_cpu(pt.t),1);
+	uint8_t elev_min=UINT8_MAX;
+	uint8_t elev_max=0;
+	for (int i=0;i<n;i++){
+		memcpy(&pt,arc+sizeof(hdr)+i*sizeof(pt),sizeof(pt));
+		xf[i]=sys_le16_to_cpu(pt.t)/tspan;
+		yf[i]=pt.elevation;
+		elev_min=MIN(elev_min,pt.elevation);
+		elev_max=MAX(elev_max,pt.elevation);
+	}
+	if (elev_max-elev_min < GNSSIR_MIN_ELEV_SPAN || polyfit2(xf,yf,n,c) != GNSSIR_SUCCESS){
+		return GNSSIR_ERR_QUALITY;
+	}
+
+	/* linear SNR versus sin(elevation) */
+	for (int i=0;i<n;i++){
+		memcpy(&pt,arc+sizeof(hdr)+i*sizeof(pt),sizeof(pt));
+		float elev=c[0]+(c[1]+c[2]*xf[i])*xf[i];
+		xf[i]=sinf(elev*PI_F/180.0f);
+		yf[i]=powf(10.0f,sys_le16_to_cpu(pt.cn0)/200.0f);
+	}
+
+	/* remove the direct signal (trend) */
+	if (polyfit2(xf,yf,n,c) != GNSSIR_SUCCESS){
+		return GNSSIR_ERR_QUALITY;
+	}
+	float yscale=0.0f;
+	for (int i=0;i<n;i++){
+		yf[i]-=c[0]+(c[1]+c[2]*xf[i])*xf[i];
+		yscale=MAX(yscale,fabsf(yf[i]));
+	}
+	if (yscale == 0.0f){
+		return GNSSIR_ERR_QUALITY;
+	}
+	for (int i=0;i<n;i++){
+		xq[i]=(uint16_t)lrintf(CLAMP(xf[i],0.0f,1.0f)*UINT16_MAX);
+		yq[i]=(int16_t)lrintf(yf[i]/yscale*INT16_MAX);
+	}
+
+	/* periodogram, keeping the highest peak and its neighbours */
+	int nheights=(CONFIG_GNSSR_GNSSIR_MAX_RH-CONFIG_GNSSR_GNSSIR_MIN_RH)/CONFIG_GNSSR_GNSSIR_RH_STEP+1;
+	float sum=0.0f;
+	float prev=0.0f;
+	float best=0.0f;
+	float left=0.0f;
+	float right=0.0f;
+	int kbest=-1;
+	for (int k=0;k<nheights;k++){
+		float height=(CONFIG_GNSSR_GNSSIR_MIN_RH+k*CONFIG_GNSSR_GNSSIR_RH_STEP)*1e-3f;
+		uint32_t fq8=(uint32_t)lrintf(2.0f*height/(float)GNSSIR_L1_WAVELENGTH*256.0f);
+		float amp=ls_amplitude(n,fq8);
+		sum+=amp;
+		if (amp > best){
+			best=amp;
+			left=prev;
+			kbest=k;
+		}else if (k == kbest+1){
+			right=amp;
+		}
+		prev=amp;
+	}
+
+	/* a peak at the edge of the range is most likely outside of it */
+	float pnr=best*nheights/MAX(sum,1e-12f);
+	if (kbest <= 0 || kbest >= nheights-1 || pnr*10.0f < CONFIG_GNSSR_GNSSIR_MIN_PNR){
+		return GNSSIR_ERR_QUALITY;
+	}
+	float denom=left-2.0f*best+right;
+	float offset=(denom < 0.0f) ? CLAMP(0.5f*(left-right)/denom,-0.5f,0.5f) : 0.0f;
+
+	memcpy(&pt,arc+sizeof(hdr)+(n-1)*sizeof(pt),sizeof(pt));
+	uint16_t az0=sys_le16_to_cpu(hdr.azimuth0);
+	uint16_t az1=sys_le16_to_cpu(hdr.azimuth1);
+	res->utc=sys_le32_to_cpu(hdr.utc)+sys_le16_to_cpu(pt.t)/2;
+	res->sv=sys_le16_to_cpu(hdr.sv);
+	res->signal=hdr.signal;
+	res->flags=hdr.flags;
+	res->azimuth=(az0+((az1-az0+540)%360-180)/2+360)%360;
+	res->height=(uint16_t)lrintf(CONFIG_GNSSR_GNSSIR_MIN_RH+(kbest+offset)*CONFIG_GNSSR_GNSSIR_RH_STEP);
+	res->amplitude=(uint16_t)MIN(lrintf(best*yscale*100.0f),UINT16_MAX);
+	res->pnr=(uint16_t)MIN(lrintf(pnr*100.0f),UINT16_MAX);
+	res->npoints=n;
+	res->elev_min=elev_min;
+	res->elev_max=elev_max;
+	return GNSSIR_SUCCESS;
+}
+
+/* one line of the retrievals file, see GNSSIR_COLUMNS */
+int gnssir_format(const struct gnssir_result * res, char * buf, size_t buflen){
+	return snprintf(buf,buflen,"%lu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",(unsigned long)res->utc,res->sv,res->signal,res->flags,
+			res->azimuth,res->height,res->amplitude,res->pnr,res->npoints,res->elev_min,res->elev_max);
+}
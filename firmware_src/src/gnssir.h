@@ -0,0 +1,57 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Reflector height retrieval (GNSS interferometric reflectometry) from a completed SNR arc
+ * (see snrarc.h). The reflected signal makes the SNR oscillate as cos(4*pi*h/lambda*sin(e)+phi),
+ * with h the height of the antenna above the reflecting surface. The retrieval:
+ *   1. smooths the (whole degree) elevations with a quadratic fit versus time,
+ *   2. converts C/N0 to a linear SNR and removes a quadratic trend versus sin(e),
+ *   3. evaluates a Lomb-Scargle periodogram for heights between CONFIG_GNSSR_GNSSIR_MIN_RH and
+ *      CONFIG_GNSSR_GNSSIR_MAX_RH, using Q15 samples, a Q15 sine table and 64 bit accumulators,
+ *   4. refines the highest peak with a parabola through its neighbours.
+ * A retrieval is rejected when the peak is less than CONFIG_GNSSR_GNSSIR_MIN_PNR/10 times the
+ * mean of the periodogram amplitudes (peak to noise ratio).
+ */
+
+#ifndef GNSSIR_H
+#define GNSSIR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define GNSSIR_SUCCESS 0
+#define GNSSIR_ERR_ARC -1 /* not a valid arc record */
+#define GNSSIR_ERR_QUALITY -2 /* no clear periodogram peak */
+
+/* wavelength of the GPS (and QZSS) L1 signal [m] */
+#define GNSSIR_L1_WAVELENGTH 0.190293672798
+
+/* chunk size of the retrievals log stream (a few lines per day) */
+#define GNSSIR_CHUNK_SIZE 1024
+
+/* columns of the retrievals file (one line per arc, after the JSON header) */
+#define GNSSIR_COLUMNS "utc,sv,signal,flags,azimuth,height_mm,amplitude,pnr,npoints,elev_min,elev_max\n"
+
+struct gnssir_result {
+	uint32_t utc; /* middle of the arc, seconds since 1970 */
+	uint16_t sv;
+	uint8_t signal;
+	uint8_t flags; /* flags of the arc (SNRARC_RISING, ...) */
+	uint16_t azimuth; /* mean azimuth [deg] */
+	uint16_t height; /* reflector height [mm] */
+	uint16_t amplitude; /* amplitude of the SNR oscillation [0.01 V/V] */
+	uint16_t pnr; /* peak to noise ratio [0.01] */
+	uint16_t npoints;
+	uint8_t elev_min; /* [deg] */
+	uint8_t elev_max; /* [deg] */
+};
+
+void gnssir_init(void);
+int gnssir_retrieve(const uint8_t * arc, size_t narc, struct gnssir_result * res);
+int gnssir_format(const struct gnssir_result * res, char * buf, size_t buflen);
+
+#endif /* GNSSIR_H */
@@ -8,16 +8,39 @@
 #include <zephyr/kernel.h>
 #include <nrf_modem_gnss.h>
 #include <stdio.h>
+#include <string.h>
 #include "featherw_datalogger.h"
 #include "lz4file.h"
+#include "lz4hc.h"
 #include "config.h"
 #include "gnss.h"
+#include "spscring.h"
+#include "pvtrecord.h"
+#include "pipeline.h"
+#ifdef CONFIG_GNSSR_PVT_COLUMNS
+#include "pvtcolumns.h"
+#endif
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+#include "nmea_filter.h"
+#endif
+#ifdef CONFIG_GNSSR_SNR_ARCS
+#include "snrarc.h"
+#endif
+#ifdef CONFIG_GNSSR_GNSSIR
+#include "gnssir.h"
+#endif
+#ifdef CONFIG_GNSSR_RAWLOG
+#include "rawlog.h"
+#endif
 #include "modem.h"
 #include "led_buttons.h"
 
 #ifdef CONFIG_UPLOAD_CLIENT
 #include "uploadclient.h"
 #endif 
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+#include "upload_manifest.h"
+#endif
 
 #ifdef CONFIG_SUPL_CLIENT_LIB
 #include "supl_support.h"
@@ -28,20 +51,97 @@ LOG_MODULE_REGISTER(GNSSR,CONFIG_GNSSR_LOG_LEVEL);
 
 /*state variabless*/
 static uint64_t                 log_timestamp;
+static uint64_t                 hk_timestamp;
+
+/* log streams: each type of data is compressed into its own file */
+#define LOGSTREAM_NMEA 0
+#define LOGSTREAM_HK 1
+#define LOGSTREAM_PVT 2
+#define LOGSTREAM_ARC 3 /* only with CONFIG_GNSSR_SNR_ARCS */
+#define LOGSTREAM_RH 4 /* only with CONFIG_GNSSR_GNSSIR */
+#if defined(CONFIG_GNSSR_GNSSIR)
+#define NLOGSTREAMS 5
+#elif defined(CONFIG_GNSSR_SNR_ARCS)
+#define NLOGSTREAMS 4
+#else
+#define NLOGSTREAMS 3
+#endif
+/* the NMEA and PVT streams are never open at the same time, the others all take a compression context */
+BUILD_ASSERT(NLOGSTREAMS-1 <= CONFIG_LZ4STREAM_CONTEXT_POOL_SIZE, "CONFIG_LZ4STREAM_CONTEXT_POOL_SIZE is too small for the log streams");
+
+struct logstream {
+	lz4streamfile lz4fid;
+	const char * suffix; /* appended to the base name of the log file */
+	char * chunkbuf;
+	size_t chunksize;
+	bool independent; /* low rate streams use independent blocks to save memory */
+	const char * header; /* written after the JSON header (optional) */
+};
 
-/* Note: the actual message queue  and semaphore are defined in gnss.c */
-extern struct k_msgq nmea_queue;
+static char nmea_chunkbuf[LZ4_CHUNKBUF_SIZE(CONFIG_GNSSR_NMEA_CHUNK_SIZE)];
+static char hk_chunkbuf[LZ4_CHUNKBUF_SIZE(CONFIG_GNSSR_HK_CHUNK_SIZE)];
+#ifdef CONFIG_GNSSR_SNR_ARCS
+static char arc_chunkbuf[LZ4_CHUNKBUF_SIZE(CONFIG_GNSSR_ARC_CHUNK_SIZE)];
+#endif
+#ifdef CONFIG_GNSSR_GNSSIR
+static char rh_chunkbuf[LZ4_CHUNKBUF_SIZE(GNSSIR_CHUNK_SIZE)];
+#endif
+
+/* the NMEA and PVT streams are alternatives (see logstream_active), so they share a chunk buffer */
+static struct logstream logstreams[NLOGSTREAMS]={
+	[LOGSTREAM_NMEA]={.suffix="",.chunkbuf=nmea_chunkbuf,.chunksize=CONFIG_GNSSR_NMEA_CHUNK_SIZE,.independent=false},
+	[LOGSTREAM_HK]={.suffix="_hk",.chunkbuf=hk_chunkbuf,.chunksize=CONFIG_GNSSR_HK_CHUNK_SIZE,.independent=true},
+	[LOGSTREAM_PVT]={.suffix="_pvt",.chunkbuf=nmea_chunkbuf,.chunksize=CONFIG_GNSSR_NMEA_CHUNK_SIZE,.independent=false},
+#ifdef CONFIG_GNSSR_SNR_ARCS
+	[LOGSTREAM_ARC]={.suffix="_arc",.chunkbuf=arc_chunkbuf,.chunksize=CONFIG_GNSSR_ARC_CHUNK_SIZE,.independent=true},
+#endif
+#ifdef CONFIG_GNSSR_GNSSIR
+	[LOGSTREAM_RH]={.suffix="_rh",.chunkbuf=rh_chunkbuf,.chunksize=GNSSIR_CHUNK_SIZE,.independent=true,.header=GNSSIR_COLUMNS},
+#endif
+};
+
+#ifdef CONFIG_GNSSR_PVT_COLUMNS
+/* PVT records of the epochs which still need to be written */
+static struct pvtcolumns pvtcols;
+#endif
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+static struct nmea_filter nmeafilter;
+#endif
+
+/* Note: the actual GNSS data ring buffer is defined in gnss.c */
+SPSCRING_DECLARE(gnss_ring);
+#ifdef CONFIG_GNSSR_SNR_ARCS
+SPSCRING_DECLARE(snr_ring);
+#endif
 K_SEM_DEFINE(rollover_event_sem, 0, 1);
 
+/* compression tiers of the GNSS data stream, from cheapest to smallest output */
+#define LZ4TIER_ACCEL 0
+#define LZ4TIER_FAST 1
+#define LZ4TIER_HC 2
+
+static const int lz4tier_levels[]={CONFIG_GNSSR_LZ4_ACCEL_LEVEL,CONFIG_GNSSR_LZ4_FAST_LEVEL,CONFIG_GNSSR_LZ4_HC_LEVEL};
+static int lz4tier=LZ4TIER_HC;
+static uint32_t gnss_ring_peak; /* highest fill level [bytes] of the GNSS data ring since the last rollover */
+static uint32_t dropped_prev;
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+static uint32_t lz4waits_prev;
+#endif
+
 
 
-static struct k_poll_event events[2] = {
+static struct k_poll_event events[] = {
 	K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
 					K_POLL_MODE_NOTIFY_ONLY,
 					&rollover_event_sem, 0),
-	K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+	K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
+					K_POLL_MODE_NOTIFY_ONLY,
+					&gnss_ring_avail, 0),
+#ifdef CONFIG_GNSSR_SNR_ARCS
+	K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
 					K_POLL_MODE_NOTIFY_ONLY,
-					&nmea_queue, 0),
+					&snr_ring_avail, 0),
+#endif
 };
 
 /* config with defaults  (instance defined in config.h)*/
@@ -50,45 +150,105 @@ extern struct config confdata;
 extern char jsonbuf[JSONBUFLEN];
 
 #ifdef CONFIG_UPLOAD_CLIENT
+/* upload log files and their index sidecars (the small reflector height files first) */
+static const char * upload_suffixes[]={"_rh.lz4",".lz4",".idx"};
+
+/* the upload pass of a file: the first suffix it ends with (or -1), so that every file is visited once */
+static int upload_pass(const char * name){
+	size_t nname=strlen(name);
+	for (int i=0;i<ARRAY_SIZE(upload_suffixes);i++){
+		size_t nsuffix=strlen(upload_suffixes[i]);
+		if (nname >= nsuffix && strcmp(name+nname-nsuffix,upload_suffixes[i]) == 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
 void sync_files(){
 	if (confdata.upload == 1){
 		int prev_ledstatus=get_led_status();
 		set_led_status(LED_UPLOADING);
 		LOG_INF("Syncing data files");
-		char lz4file[50];
+		char lz4file[64];
 		char lz4fullfile[100];
 		char lz4renamed[103];
+#ifndef CONFIG_GNSSR_UPLOAD_MANIFEST
 		char datadir[50];
 		struct fs_dir_t dirp;
 		(void)get_sd_data_path(datadir,NULL);
-		(void) lsdir_init(datadir, &dirp);	
+#endif
 
 		bool lte_active=false;
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+		/* queue the files which did not fit in the manifest before */
+		manifest_rescan();
+#endif
 		
-		while(lsdir_next(".lz4",&dirp,lz4file) == 0){
-			if(!lte_active){
-				stop_gnss();
-				lte_connect();
-				lte_active=true;
+		for (int i=0;i<ARRAY_SIZE(upload_suffixes);i++){
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+			/* only the files in the manifest are pending */
+			for (int j=0;j<manifest_count();){
+				const struct manifest_entry * entry=manifest_get(j);
+				if (upload_pass(entry->name) != i){
+					j++;
+					continue;
+				}
+				strcpy(lz4file,entry->name);
+				(void)get_sd_data_path(lz4fullfile,lz4file);
+				if (!file_exists(lz4fullfile)){
+					LOG_WRN("Queued file %s is no longer on the sdcard",lz4file);
+					manifest_done(lz4file);
+					continue;
+				}
+				if (file_size(lz4fullfile) != entry->size){
+					LOG_WRN("Size of %s differs from the %u bytes in the upload manifest",lz4file,entry->size);
+				}
+#else
+			fs_dir_t_init(&dirp);
+			if (lsdir_init(datadir, &dirp) != 0){
+				break;
 			}
-			(void)get_sd_data_path(lz4fullfile,lz4file);
-			printk("Uploading lz4file found %s\n",lz4fullfile);
-			if(webdavUploadFile(lz4fullfile,&confdata) == UPLOADCLNT_SUCCESS){
-				/*rename file */
-				LOG_INF("Sucessfully uploaded file %s, renaming",lz4file);
-				strcpy(lz4renamed,lz4fullfile);
-				strcat(lz4renamed,"_ok");
-				fs_rename(lz4fullfile,lz4renamed);
-			}else{
-				LOG_INF("cannot currently upload file %s, trying later",lz4file);
+			while(lsdir_next(upload_suffixes[i],&dirp,lz4file,sizeof(lz4file)) == 0){
+				if (upload_pass(lz4file) != i){
+					/* visited in an earlier pass */
+					continue;
+				}
+#endif
+				if(!lte_active){
+					stop_gnss();
+					lte_connect();
+					lte_active=true;
+				}
+				(void)get_sd_data_path(lz4fullfile,lz4file);
+				printk("Uploading lz4file found %s\n",lz4fullfile);
+				if(webdavUploadFile(lz4fullfile,&confdata) == UPLOADCLNT_SUCCESS){
+					/*rename file */
+					LOG_INF("Sucessfully uploaded file %s, renaming",lz4file);
+					strcpy(lz4renamed,lz4fullfile);
+					strcat(lz4renamed,"_ok");
+					fs_rename(lz4fullfile,lz4renamed);
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+					manifest_done(lz4file);
+#endif
+				}else{
+					LOG_INF("cannot currently upload file %s, trying later",lz4file);
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+					manifest_failed(lz4file);
+					j++;
+#endif
+				}
 			}
+#ifndef CONFIG_GNSSR_UPLOAD_MANIFEST
+			(void) lsdir_close(&dirp);	
+#endif
 		}
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+		manifest_compact();
+#endif
 
 
 
-		(void) lsdir_close(&dirp);	
-
-
 		if (lte_active){
 			LOG_INF("Closing LTE link and restarting GNSS\n");
 			lte_disconnect();
@@ -108,37 +268,252 @@ void sync_files(){
 
 
 
-/* open a new unused logging stream */
-int rollover_lz4log(lz4streamfile * lz4fid){
+/* repair log files which were not properly closed (e.g. after a power loss) */
+void recover_lz4logs(){
+	char tmpfile[64];
+	char tmpfullfile[100];
+	char datadir[50];
+	struct fs_dir_t dirp;
+	fs_dir_t_init(&dirp);
+	(void)get_sd_data_path(datadir,NULL);
+	if (lsdir_init(datadir, &dirp) != 0){
+		return;
+	}
+
+	while(lsdir_next(".tmp",&dirp,tmpfile,sizeof(tmpfile)) == 0){
+		(void)get_sd_data_path(tmpfullfile,tmpfile);
+		LOG_INF("Recovering unfinished log file %s",tmpfullfile);
+		if (lz4recover(tmpfullfile) != LZ4_SUCCESS){
+			LOG_ERR("Could not recover %s",tmpfullfile);
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+		}else{
+			/* queue the recovered file without the .tmp suffix */
+			tmpfullfile[strlen(tmpfullfile)-4]='\0';
+			manifest_add_file(tmpfullfile);
+#endif
+		}
+	}
+
+	(void) lsdir_close(&dirp);	
+}
+
+/* write the device status to the housekeeping stream */
+static void write_housekeeping(){
+	lz4streamfile * hkfid=&logstreams[LOGSTREAM_HK].lz4fid;
+	if (!hkfid->isOpen){
+		return;
+	}
+	if (get_jsonstatus(jsonbuf,JSONBUFLEN) == CONF_SUCCESS){
+		lz4write(hkfid,jsonbuf);
+	}
+	hk_timestamp=k_uptime_get();
+}
+
+/* whether a log stream is written with the configured log mode */
+static bool logstream_active(int i){
+	switch (i){
+		case LOGSTREAM_NMEA:
+			return confdata.log_mode == LOG_MODE_NMEA;
+		case LOGSTREAM_PVT:
+			return confdata.log_mode == LOG_MODE_PVT;
+		default:
+			return true;
+	}
+}
+
+/* stream which receives the records from the GNSS data ring (NMEA sentences or PVT records, the
+ * ring stays empty when only SNR arcs are logged) */
+static lz4streamfile * gnss_logstream(void){
+	return &logstreams[(confdata.log_mode == LOG_MODE_PVT) ? LOGSTREAM_PVT : LOGSTREAM_NMEA].lz4fid;
+}
+
+/* write a record from the GNSS data ring to the log */
+static void write_gnss_record(lz4streamfile * gnssfid, const char * record, size_t nrecord){
+#ifdef CONFIG_GNSSR_PVT_COLUMNS
+	if (confdata.log_mode == LOG_MODE_PVT){
+		/* PVT records are collected and written in columnar blocks */
+		if (pvtcol_add(&pvtcols,(const uint8_t *)record,nrecord,gnssfid) != LZ4_SUCCESS){
+			LOG_ERR("Cannot write PVT block");
+		}
+		pipeline.written++;
+		pipeline.bytes_written+=nrecord;
+		return;
+	}
+#endif
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+	if (confdata.log_mode == LOG_MODE_NMEA){
+		/* filtered sentences are never compressed or written */
+		static char filtered[NRF_MODEM_GNSS_NMEA_MAX_LEN];
+		record=nmea_filter_apply(&nmeafilter,record,nrecord,filtered,&nrecord);
+		if (record == NULL){
+			pipeline.dropped_filter++;
+			return;
+		}
+	}
+#endif
+	lz4mark(gnssfid,gnss_get_unixtime());
+	lz4write_n(gnssfid,record,nrecord);
+	pipeline.written++;
+	pipeline.bytes_written+=nrecord;
+}
+
+#ifdef CONFIG_GNSSR_GNSSIR
+/* estimate the reflector height from a completed SNR arc and write it to the retrievals file */
+static void write_retrieval(const uint8_t * arc, size_t narc){
+	lz4streamfile * rhfid=&logstreams[LOGSTREAM_RH].lz4fid;
+	struct gnssir_result res;
+	char line[80];
+
+	if (!rhfid->isOpen || gnssir_retrieve(arc,narc,&res) != GNSSIR_SUCCESS){
+		return;
+	}
+	LOG_INF("Reflector height from satellite %u: %u mm",res.sv,res.height);
+	gnssir_format(&res,line,sizeof(line));
+	lz4write(rhfid,line);
+}
+#endif
+
+#ifdef CONFIG_GNSSR_SNR_ARCS
+/* write a completed SNR arc to its log (and retrieve the reflector height from it) */
+static void write_arc(const uint8_t * arc, size_t narc, void * ctx){
+	lz4streamfile * arcfid=&logstreams[LOGSTREAM_ARC].lz4fid;
+
+	ARG_UNUSED(ctx);
+	if (arcfid->isOpen){
+		lz4write_n(arcfid,arc,narc);
+	}
+#ifdef CONFIG_GNSSR_GNSSIR
+	write_retrieval(arc,narc);
+#endif
+}
+#endif
+
+/* Choose the compression level of the next GNSS data log from the backlog during the previous one and the
+ * battery voltage. HC gives the smallest uploads but costs CPU time: fall back to an accelerated level
+ * as soon as GNSS records pile up or get dropped, to the normal fast level on a low battery, and
+ * move up one tier per rollover while the ring stays at most half full */
+static int select_lz4level(const lz4streamfile * gnssfid){
+	/* records which did not fit in the ring (the other losses don't depend on the level) */
+	uint32_t dropped=pipeline.dropped_ring-dropped_prev;
+	uint32_t waits=0;
+	uint16_t mvolt=get_battery_mvolt();
+
+	dropped_prev+=dropped;
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+	/* the producer had to wait for the writer thread to compress the previous chunk */
+	waits=gnssfid->nwaits-lz4waits_prev;
+	lz4waits_prev=gnssfid->nwaits;
+#endif
+
+	if (dropped > 0 || waits > 0 || 4*gnss_ring_peak >= 3*gnss_ring.size){
+		lz4tier=LZ4TIER_ACCEL;
+	}else if (mvolt != 9999 && mvolt < CONFIG_GNSSR_LZ4_HC_MIN_MVOLT){
+		lz4tier=MIN(lz4tier,LZ4TIER_FAST);
+	}else if (2*gnss_ring_peak <= gnss_ring.size && lz4tier < LZ4TIER_HC){
+		lz4tier++;
+	}
+	if (lz4tier == LZ4TIER_HC && gnssfid->dict != NULL && lz4tier_levels[LZ4TIER_HC] >= LZ4HC_CLEVEL_MIN){
+		/* dictionaries are only digested for the fast compressor, HC would ignore it */
+		lz4tier=LZ4TIER_FAST;
+	}
+	LOG_INF("GNSS data backlog: at most %u of %u bytes buffered, %u dropped, %u writer waits, battery %u mV: lz4 level %d",
+			gnss_ring_peak,gnss_ring.size,dropped,waits,mvolt,lz4tier_levels[lz4tier]);
+	gnss_ring_peak=0;
+	return lz4tier_levels[lz4tier];
+}
+
+/* add the output of a closed GNSS data log to the pipeline counters */
+static void count_closed_log(const lz4streamfile * gnssfid){
+	pipeline.bytes_compressed+=gnssfid->nbytes;
+	pipeline.syncs+=gnssfid->nsyncs;
+#ifdef CONFIG_LZ4STREAM_WRITER_THREAD
+	/* counted since boot by the stream itself */
+	pipeline.writer_waits=gnssfid->nwaits;
+#endif
+}
+
+/* close the current log files and open new ones for all streams */
+int rollover_lz4log(){
 
 	char filenamebase[55];
 	char datestr[18];
+	int stat=0;
 	
 	
-	/* File potentially needs closing */
-	if (lz4fid->isOpen){
-		lz4close(lz4fid);
+#ifdef CONFIG_GNSSR_PVT_COLUMNS
+	/* write the last (incomplete) block of PVT records */
+	if (gnss_logstream()->isOpen){
+		pvtcol_flush(&pvtcols,gnss_logstream());
+	}
+#endif
+
+	/* Files potentially need closing */
+	for (int i=0;i<NLOGSTREAMS;i++){
+		if (logstreams[i].lz4fid.isOpen){
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+			/* queue the closed file (and its index) for uploading, unless it went to the raw partition */
+			lz4streamfile * lz4fid=&logstreams[i].lz4fid;
+			char closedfile[sizeof(lz4fid->filename)+4];
+			strcpy(closedfile,lz4fid->filename);
+			bool indexed=lz4fid->idxOpen;
+			bool queue=(lz4fid->sink == NULL);
+			if (lz4close(lz4fid) == LZ4_SUCCESS && queue){
+				manifest_add(closedfile,lz4fid->nbytes,lz4fid->hash);
+				if (indexed){
+					strcat(closedfile,".idx");
+					manifest_add_file(closedfile);
+				}
+			}
+#else
+			lz4close(&logstreams[i].lz4fid);
+#endif
+			if (&logstreams[i].lz4fid == gnss_logstream()){
+				count_closed_log(&logstreams[i].lz4fid);
+			}
+		}
 	}
 	
 	gnss_get_current_datetimestr(datestr);
 
-	sprintf(filenamebase,"%s_%s.lz4",confdata.filebase,datestr);
+	lz4streamfile * gnssfid=gnss_logstream();
+	lz4setlevel(gnssfid,select_lz4level(gnssfid));
+
+	for (int i=0;i<NLOGSTREAMS;i++){
+		lz4streamfile * lz4fid=&logstreams[i].lz4fid;
+		if (!logstream_active(i)){
+			continue;
+		}
+
+		sprintf(filenamebase,"%s_%s%s.lz4",confdata.filebase,datestr,logstreams[i].suffix);
 			
-	get_sd_data_path(lz4fid->filename, filenamebase);
-	
-	LOG_INF("Opening %s",lz4fid->filename);		
-	
-	if (lz4open(lz4fid->filename,lz4fid) != LZ4_SUCCESS){
-	
-		return -1;
+		get_sd_data_path(lz4fid->filename, filenamebase);
+		
+		LOG_INF("Opening %s",lz4fid->filename);		
+		
+		/* apply the configured durability policy */
+		lz4setsync(lz4fid,confdata.sync_mode,confdata.sync_value);
+		lz4setindependent(lz4fid,logstreams[i].independent);
+		/* only the GNSS data stream is indexed by time */
+		lz4setindex(lz4fid,(lz4fid == gnssfid) ? confdata.index_interval : 0);
+		/* and only its size is worth allocating up front */
+		lz4setprealloc(lz4fid,(lz4fid == gnssfid) ? (size_t)MAX(confdata.prealloc_kb,0)*1024 : 0);
+		
+		if (lz4open(lz4fid->filename,lz4fid) != LZ4_SUCCESS){
+			stat=-1;
+			continue;
+		}
+		///Write JSON header with the device status
+		get_jsonstatus(jsonbuf,JSONBUFLEN);
+		lz4write(lz4fid,jsonbuf);
+		if (logstreams[i].header != NULL){
+			lz4write(lz4fid,logstreams[i].header);
+		}
 	}
-	///Write JSON header with the device status
-	get_jsonstatus(jsonbuf,JSONBUFLEN);
-	lz4write(lz4fid,jsonbuf);
 	
 	log_timestamp=k_uptime_get();
+	hk_timestamp=log_timestamp;
 
-	return 0;
+	return stat;
 
 }
 
@@ -176,6 +551,11 @@ int main(void)
 		return -1;
 	}
 
+#ifdef CONFIG_GNSSR_UPLOAD_MANIFEST
+	manifest_load();
+#endif
+	recover_lz4logs();
+
 	LOG_INF("Loading config data");
 	/* read configuration */
 	if (read_config(&confdata) != CONF_SUCCESS){
@@ -202,10 +582,48 @@ int main(void)
 	LOG_INF("Starting GNSS-R logger application\n");
 
 
-	static struct lz4streamfile lz4fid ;
-	init_lz4stream(&lz4fid,true);
+	for (int i=0;i<NLOGSTREAMS;i++){
+		init_lz4stream(&logstreams[i].lz4fid,logstreams[i].chunkbuf,logstreams[i].chunksize,true);
+	}
+#ifdef CONFIG_GNSSR_RAWLOG
+	/* log to the raw partition when the card has one */
+	static struct rawlog_file rawfiles[NLOGSTREAMS];
+	if (rawlog_mount("SD") == RAWLOG_SUCCESS){
+		for (int i=0;i<NLOGSTREAMS;i++){
+			lz4setsink(&logstreams[i].lz4fid,rawlog_sink(&rawfiles[i]));
+		}
+	}else{
+		LOG_WRN("No raw log partition found on the sdcard, logging to files");
+	}
+#endif
+	lz4streamfile * nmeafid=&logstreams[LOGSTREAM_NMEA].lz4fid;
+	lz4streamfile * gnssfid=gnss_logstream();
+#ifdef CONFIG_GNSSR_PVT_COLUMNS
+	pvtcol_init(&pvtcols);
+#endif
+#ifdef CONFIG_GNSSR_NMEA_FILTER
+	nmea_filter_init(&nmeafilter,&confdata.nmea_filter);
+#endif
+#ifdef CONFIG_GNSSR_GNSSIR
+	gnssir_init();
+#endif
+
+	/* use a preset dictionary for the logs when it is provided on the sdcard */
+	static lz4dict nmeadict;
+	char dictfile[100];
+	get_sd_config_path(dictfile,"nmea.dict");
+	if (file_exists(dictfile) && lz4loaddict(dictfile,&nmeadict) == LZ4_SUCCESS){
+		lz4setdict(nmeafid,&nmeadict);
+		if (lz4tier_levels[LZ4TIER_HC] >= LZ4HC_CLEVEL_MIN){
+			LOG_INF("NMEA logs use the fast compressor (level %d at most) with the dictionary",
+					lz4tier_levels[LZ4TIER_FAST]);
+		}
+	}
 		
 	/* start and initialize gnss */
+#ifdef CONFIG_GNSSR_SNR_ARCS
+	gnss_init_arcs(write_arc,NULL);
+#endif
 
 	if (init_gnss(confdata.agps) !=0){
 		set_led_status(LED_ERROR);
@@ -221,19 +639,19 @@ int main(void)
 	LOG_INF("Getting GNSS data...\n");
 	set_led_status(LED_SEARCHING);
 
-	struct nrf_modem_gnss_nmea_data_frame *nmea_data;
+	static char gnss_record[MAX(NRF_MODEM_GNSS_NMEA_MAX_LEN,PVTREC_MAXSIZE)];
 	
 	/* start polling loop */
 	for (;;) {
-		/* wait for a nmea message, log_rollover event or pvt_fix */
-		(void)k_poll(events, 2, K_FOREVER);
+		/* wait for a nmea message, log_rollover event, pvt_fix or SNR samples */
+		(void)k_poll(events, ARRAY_SIZE(events), K_FOREVER);
 		
 		
 		
 		/* Check for log rollover */
 		if (events[0].state == K_POLL_STATE_SEM_AVAILABLE &&
 		    k_sem_take(events[0].sem, K_NO_WAIT) == 0) {
-			if(rollover_lz4log(&lz4fid) != 0){
+			if(rollover_lz4log() != 0){
 				LOG_ERR("failed to roll over log file");
 			}
 
@@ -245,20 +663,35 @@ int main(void)
 		}	
 		
 		
-		/* Handle new NMEA data */
-		if (events[1].state == K_POLL_STATE_MSGQ_DATA_AVAILABLE){
-				/*only get nmea data and write it to file when the log is open and there is a position fix*/
-				if(k_msgq_get(events[1].msgq, &nmea_data, K_NO_WAIT) == 0){
-					if(lz4fid.isOpen && got_fix()){
-						lz4write(&lz4fid,nmea_data->nmea_str);	
-					}
-					/*free the nmea_data to make room for a new message */
-					k_free(nmea_data);
+		/* Handle new NMEA data or PVT records */
+		if (events[1].state == K_POLL_STATE_SEM_AVAILABLE &&
+		    k_sem_take(events[1].sem, K_NO_WAIT) == 0){
+				/*only get gnss data and write it to file when the log is open and there is a position fix*/
+				gnss_ring_peak=MAX(gnss_ring_peak,spscring_used(&gnss_ring));
+				int nrecord=spscring_get(&gnss_ring,gnss_record,sizeof(gnss_record));
+				if(nrecord > 0 && gnssfid->isOpen && got_fix()){
+					write_gnss_record(gnssfid,gnss_record,nrecord);
+				}else if (nrecord > 0){
+					pipeline.dropped_nofix++;
 				}
 			events[1].state = K_POLL_STATE_NOT_READY;
 
 		}	
 
+#ifdef CONFIG_GNSSR_SNR_ARCS
+		/* Add SNR samples to the arcs (completed arcs are written by write_arc) */
+		if (events[2].state == K_POLL_STATE_SEM_AVAILABLE &&
+		    k_sem_take(events[2].sem, K_NO_WAIT) == 0){
+			gnss_update_arcs();
+			events[2].state = K_POLL_STATE_NOT_READY;
+		}
+#endif
+
+		/* periodically log the device status */
+		if (k_uptime_get()-hk_timestamp >= (int64_t)CONFIG_GNSSR_HK_INTERVAL*MSEC_PER_SEC){
+			write_housekeeping();
+		}
+
 	}
 
 
@@ -0,0 +1,229 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <string.h>
+#include "nmea_parse.h"
+#include "nmea_filter.h"
+
+struct name_bit {
+	const char * name;
+	uint8_t bit;
+};
+
+static const struct name_bit sentence_names[]={
+	{"GGA",NMEA_SENTENCE_GGA},
+	{"GLL",NMEA_SENTENCE_GLL},
+	{"GSA",NMEA_SENTENCE_GSA},
+	{"GSV",NMEA_SENTENCE_GSV},
+	{"RMC",NMEA_SENTENCE_RMC},
+};
+
+static const struct name_bit constellation_names[]={
+	{"GPS",NMEA_CONST_GPS},
+	{"SBAS",NMEA_CONST_SBAS},
+	{"QZSS",NMEA_CONST_QZSS},
+	{"GLONASS",NMEA_CONST_GLONASS},
+	{"GALILEO",NMEA_CONST_GALILEO},
+	{"BEIDOU",NMEA_CONST_BEIDOU},
+};
+
+/* constellations which are always identified by their talker */
+static const struct name_bit constellation_talkers[]={
+	{"GL",NMEA_CONST_GLONASS},
+	{"GA",NMEA_CONST_GALILEO},
+	{"GB",NMEA_CONST_BEIDOU},
+	{"BD",NMEA_CONST_BEIDOU},
+	{"GQ",NMEA_CONST_QZSS},
+};
+
+static uint8_t lookup(const struct name_bit * table, size_t n, const char * name, size_t len){
+	for (size_t i=0;i<n;i++){
+		if (strlen(table[i].name) == len && memcmp(table[i].name,name,len) == 0){
+			return table[i].bit;
+		}
+	}
+	return 0;
+}
+
+uint8_t nmea_filter_sentence(const char * name){
+	return lookup(sentence_names,sizeof(sentence_names)/sizeof(sentence_names[0]),name,strlen(name));
+}
+
+uint8_t nmea_filter_constellation(const char * name){
+	return lookup(constellation_names,sizeof(constellation_names)/sizeof(constellation_names[0]),name,strlen(name));
+}
+
+/* keep everything the logger wrote before the filter existed */
+void nmea_filter_defaults(struct nmea_filter_config * conf){
+	memset(conf,0,sizeof(*conf));
+	conf->sentences=NMEA_SENTENCE_GSV|NMEA_SENTENCE_RMC;
+	conf->constellations=NMEA_CONST_ALL;
+	conf->elev_min=-90;
+	conf->elev_max=90;
+	conf->nwindows=0;
+	conf->rmc_interval=1;
+}
+
+void nmea_filter_init(struct nmea_filter * flt, const struct nmea_filter_config * conf){
+	memset(flt,0,sizeof(*flt));
+	flt->conf=conf;
+}
+
+/* constellation of a GSV satellite: GP and GN sentences mix them, using the NMEA PRN ranges */
+static uint8_t sat_constellation(const char * talker, int prn){
+	uint8_t bit=lookup(constellation_talkers,sizeof(constellation_talkers)/sizeof(constellation_talkers[0]),talker,2);
+	if (bit != 0){
+		return bit;
+	}
+	if (prn <= 32){
+		return NMEA_CONST_GPS;
+	}else if (prn <= 64){
+		return NMEA_CONST_SBAS;
+	}else if (prn <= 96){
+		return NMEA_CONST_GLONASS;
+	}else if (prn >= 193 && prn <= 202){
+		return NMEA_CONST_QZSS;
+	}
+	return 0;
+}
+
+static bool azimuth_inside(const struct nmea_filter_config * conf, int azimuth){
+	for (int i=0;i<conf->nwindows;i++){
+		int from=conf->azimuth[i][0];
+		int to=conf->azimuth[i][1];
+		if ((from <= to) ? (azimuth >= from && azimuth <= to) : (azimuth >= from || azimuth <= to)){
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool keep_sat(const struct nmea_filter_config * conf, const char * talker, const struct nmea_gsv_sat * sat){
+	/* satellites of an unknown constellation only pass when the constellations aren't restricted */
+	if ((conf->constellations & NMEA_CONST_ALL) != NMEA_CONST_ALL &&
+			(sat_constellation(talker,sat->prn) & conf->constellations) == 0){
+		return false;
+	}
+	/* an unknown elevation or azimuth only passes when it isn't restricted */
+	if (sat->elevation < 0 && (conf->elev_min > 0 || conf->elev_max < 90)){
+		return false;
+	}
+	if (sat->elevation >= 0 && (sat->elevation < conf->elev_min || sat->elevation > conf->elev_max)){
+		return false;
+	}
+	if (conf->nwindows > 0 && (sat->azimuth < 0 || !azimuth_inside(conf,sat->azimuth))){
+		return false;
+	}
+	return true;
+}
+
+static void append_field(const struct nmea_sentence * snt, int i, char * buf, size_t * n){
+	buf[(*n)++]=',';
+	memcpy(buf+*n,nmea_field_ptr(snt,i),nmea_field_len(snt,i));
+	*n+=nmea_field_len(snt,i);
+}
+
+/* rewrite a GSV sentence with only the satellites in keep (a bit per entry) */
+static size_t rewrite_gsv(const struct nmea_sentence * snt, size_t len, uint8_t keep, char * buf){
+	size_t n=0;
+
+	buf[n++]='$';
+	memcpy(buf+n,nmea_field_ptr(snt,0),nmea_field_len(snt,0));
+	n+=nmea_field_len(snt,0);
+	for (int i=1;i<4;i++){
+		append_field(snt,i,buf,&n);
+	}
+	int nentries=(snt->nfields-4)/4;
+	for (int k=0;k<nentries;k++){
+		if ((keep & (1 << k)) == 0){
+			continue;
+		}
+		for (int i=4+4*k;i<8+4*k;i++){
+			append_field(snt,i,buf,&n);
+		}
+	}
+	/* signal id (NMEA 4.10) */
+	for (int i=4+4*nentries;i<snt->nfields;i++){
+		append_field(snt,i,buf,&n);
+	}
+
+	uint8_t sum=0;
+	for (size_t i=1;i<n;i++){
+		sum^=(uint8_t)buf[i];
+	}
+	/* keep the line end of the original sentence */
+	const char * star=nmea_field_ptr(snt,snt->nfields-1)+nmea_field_len(snt,snt->nfields-1);
+	size_t nend=len-(size_t)(star+3-snt->str);
+	buf[n++]='*';
+	buf[n++]="0123456789ABCDEF"[sum >> 4];
+	buf[n++]="0123456789ABCDEF"[sum & 0xf];
+	memcpy(buf+n,star+3,nend);
+	return n+nend;
+}
+
+/* Filter a sentence. Returns str when it is kept as it is, buf when it is rewritten (buf must be at
+ * least len bytes) or NULL when it is dropped; the length of what is kept is stored in outlen */
+const char * nmea_filter_apply(struct nmea_filter * flt, const char * str, size_t len, char * buf, size_t * outlen){
+	const struct nmea_filter_config * conf=flt->conf;
+	struct nmea_sentence snt;
+	struct nmea_data data;
+
+	if (nmea_parse(str,len,&snt) != NMEA_SUCCESS || nmea_field_len(&snt,0) != 5){
+		flt->dropped++;
+		return NULL;
+	}
+	const char * addr=nmea_field_ptr(&snt,0);
+	uint8_t sentence=lookup(sentence_names,sizeof(sentence_names)/sizeof(sentence_names[0]),addr+2,3);
+	if ((sentence & conf->sentences) == 0){
+		flt->dropped++;
+		return NULL;
+	}
+
+	*outlen=len;
+	if (snt.type == NMEA_TYPE_RMC && conf->rmc_interval > 1){
+		/* sentences without a time (no fix) are kept */
+		if (nmea_decode(&snt,&data) == NMEA_SUCCESS && nmea_field_len(&snt,1) > 0 &&
+				(data.rmc.time/1000)%conf->rmc_interval != 0){
+			flt->dropped++;
+			return NULL;
+		}
+	}else if (snt.type == NMEA_TYPE_GSV){
+		if (nmea_decode(&snt,&data) != NMEA_SUCCESS){
+			flt->dropped++;
+			return NULL;
+		}
+		/* the decoder skips empty entries, so match the entries to the sentence by their PRN field */
+		uint8_t keep=0;
+		int nkept=0;
+		int nentries=(snt.nfields-4)/4;
+		int j=0;
+		for (int k=0;k<nentries && k<NMEA_GSV_MAXSATS;k++){
+			if (nmea_field_len(&snt,4+4*k) == 0){
+				continue;
+			}
+			if (keep_sat(conf,addr,&data.gsv.sats[j++])){
+				keep|=1 << k;
+				nkept++;
+			}
+		}
+		if (j == 0){
+			/* e.g. no satellites in view: nothing to filter */
+			return str;
+		}
+		if (nkept == 0){
+			flt->sats_dropped+=j;
+			flt->dropped++;
+			return NULL;
+		}
+		if (nkept < j){
+			flt->sats_dropped+=j-nkept;
+			flt->rewritten++;
+			*outlen=rewrite_gsv(&snt,len,keep,buf);
+			return buf;
+		}
+	}
+	return str;
+}
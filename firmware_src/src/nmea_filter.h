@@ -0,0 +1,67 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Filter of the NMEA sentences before they are compressed, configured in the "nmea_filter" item of
+ * the config file. It drops sentence types which are not wanted, keeps one RMC sentence every
+ * rmc_interval seconds, and removes the satellites from GSV sentences which are of an unwanted
+ * constellation or outside the elevation and azimuth mask (for example when only the satellites
+ * above the water matter). A GSV sentence from which satellites are removed is rewritten with a
+ * new checksum (its message and satellite counts are left as they are), and it is dropped when no
+ * satellites remain. GSV sentences without satellites are kept as they are, and satellites of which
+ * the constellation is not known are only removed when the constellations are restricted.
+ */
+
+#ifndef NMEA_FILTER_H
+#define NMEA_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* sentence types, the bits equal those of the NMEA mask of the modem (NRF_MODEM_GNSS_NMEA_..._MASK) */
+#define NMEA_SENTENCE_GGA (1 << 0)
+#define NMEA_SENTENCE_GLL (1 << 1)
+#define NMEA_SENTENCE_GSA (1 << 2)
+#define NMEA_SENTENCE_GSV (1 << 3)
+#define NMEA_SENTENCE_RMC (1 << 4)
+
+/* constellations of the satellites in GSV sentences (from the talker, or the PRN for GP and GN) */
+#define NMEA_CONST_GPS (1 << 0)
+#define NMEA_CONST_SBAS (1 << 1)
+#define NMEA_CONST_QZSS (1 << 2)
+#define NMEA_CONST_GLONASS (1 << 3)
+#define NMEA_CONST_GALILEO (1 << 4)
+#define NMEA_CONST_BEIDOU (1 << 5)
+#define NMEA_CONST_ALL 0x3f
+
+#define NMEA_FILTER_MAX_WINDOWS 4
+
+struct nmea_filter_config {
+	uint8_t sentences; /* NMEA_SENTENCE_... of the sentences to keep */
+	uint8_t constellations; /* NMEA_CONST_... of the satellites to keep */
+	int8_t elev_min; /* [deg] */
+	int8_t elev_max; /* [deg] */
+	uint8_t nwindows; /* azimuth windows, all azimuths are kept when there are none */
+	uint16_t azimuth[NMEA_FILTER_MAX_WINDOWS][2]; /* from and to [deg], clockwise (may pass north) */
+	uint16_t rmc_interval; /* [s] */
+};
+
+struct nmea_filter {
+	const struct nmea_filter_config * conf;
+	uint32_t dropped; /* sentences dropped */
+	uint32_t rewritten; /* GSV sentences from which satellites were removed */
+	uint32_t sats_dropped; /* satellites removed from GSV sentences */
+};
+
+void nmea_filter_defaults(struct nmea_filter_config * conf);
+void nmea_filter_init(struct nmea_filter * flt, const struct nmea_filter_config * conf);
+const char * nmea_filter_apply(struct nmea_filter * flt, const char * str, size_t len, char * buf, size_t * outlen);
+
+/* bits of a sentence type ("GSV") or constellation ("GPS") name, 0 when it is unknown */
+uint8_t nmea_filter_sentence(const char * name);
+uint8_t nmea_filter_constellation(const char * name);
+
+#endif /* NMEA_FILTER_H */
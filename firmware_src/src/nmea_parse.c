@@ -0,0 +1,309 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <string.h>
+#include "nmea_parse.h"
+
+/* character classes */
+#define CC_INVALID 0
+#define CC_TEXT 1
+#define CC_COMMA 2
+#define CC_STAR 3
+
+/* printable ASCII, except for the delimiters '$' and '*' (and ',' which separates fields) */
+static const uint8_t char_class[256]={
+	[0x20 ... 0x23]=CC_TEXT,
+	[0x25 ... 0x29]=CC_TEXT,
+	['*']=CC_STAR,
+	['+']=CC_TEXT,
+	[',']=CC_COMMA,
+	[0x2d ... 0x7e]=CC_TEXT,
+};
+
+/* value of a hexadecimal digit plus one (0 when it is not one) */
+static const uint8_t hex_value[256]={
+	['0']=1,['1']=2,['2']=3,['3']=4,['4']=5,['5']=6,['6']=7,['7']=8,['8']=9,['9']=10,
+	['A']=11,['B']=12,['C']=13,['D']=14,['E']=15,['F']=16,
+	['a']=11,['b']=12,['c']=13,['d']=14,['e']=15,['f']=16,
+};
+
+static int decode_gsv(const struct nmea_sentence * snt, struct nmea_data * data);
+static int decode_rmc(const struct nmea_sentence * snt, struct nmea_data * data);
+static int decode_gga(const struct nmea_sentence * snt, struct nmea_data * data);
+
+struct nmea_type {
+	char formatter[3];
+	uint8_t type;
+	uint8_t minfields;
+	int (*decode)(const struct nmea_sentence * snt, struct nmea_data * data);
+};
+
+/* supported sentences, indexed by NMEA_TYPE_... - 1 */
+static const struct nmea_type nmea_types[]={
+	{{'G','S','V'},NMEA_TYPE_GSV,4,decode_gsv},
+	{{'R','M','C'},NMEA_TYPE_RMC,10,decode_rmc},
+	{{'G','G','A'},NMEA_TYPE_GGA,11,decode_gga},
+};
+
+/* sentence type from the address field (talker plus formatter, e.g. GPGSV) */
+static uint8_t sentence_type(const char * addr, size_t len){
+	if (len != 5){
+		return NMEA_TYPE_UNKNOWN;
+	}
+	for (size_t i=0;i<sizeof(nmea_types)/sizeof(nmea_types[0]);i++){
+		if (memcmp(addr+2,nmea_types[i].formatter,3) == 0){
+			return nmea_types[i].type;
+		}
+	}
+	return NMEA_TYPE_UNKNOWN;
+}
+
+/* Validate a sentence and split it into fields, in a single pass. The sentence should start with '$'
+ * and end with '*' and the two digit checksum, optionally followed by CR, LF or NUL characters. The
+ * fields point into str, which is not modified */
+int nmea_parse(const char * str, size_t len, struct nmea_sentence * snt){
+	while (len > 0 && (str[len-1] == '\n' || str[len-1] == '\r' || str[len-1] == '\0')){
+		len--;
+	}
+	/* shortest: $ plus an address of at least one character, and *hh */
+	if (len < 5 || len > NMEA_MAXLEN-2 || str[0] != '$'){
+		return NMEA_ERR_FORMAT;
+	}
+
+	uint8_t sum=0;
+	uint8_t nfields=0;
+	size_t start=1;
+	size_t i;
+	for (i=1;i<len;i++){
+		uint8_t c=(uint8_t)str[i];
+		uint8_t cc=char_class[c];
+		if (cc == CC_TEXT){
+			sum^=c;
+		}else if (cc == CC_COMMA){
+			if (nfields == NMEA_MAXFIELDS-1){
+				return NMEA_ERR_FORMAT;
+			}
+			sum^=c;
+			snt->fields[nfields].offset=(uint8_t)start;
+			snt->fields[nfields++].len=(uint8_t)(i-start);
+			start=i+1;
+		}else if (cc == CC_STAR){
+			break;
+		}else{
+			return NMEA_ERR_FORMAT;
+		}
+	}
+	/* the checksum must be the last thing in the sentence */
+	if (i+3 != len){
+		return NMEA_ERR_FORMAT;
+	}
+	snt->fields[nfields].offset=(uint8_t)start;
+	snt->fields[nfields++].len=(uint8_t)(i-start);
+
+	uint8_t hi=hex_value[(uint8_t)str[i+1]];
+	uint8_t lo=hex_value[(uint8_t)str[i+2]];
+	if (hi == 0 || lo == 0){
+		return NMEA_ERR_FORMAT;
+	}
+	if ((((hi-1) << 4) | (lo-1)) != sum){
+		return NMEA_ERR_CHECKSUM;
+	}
+
+	snt->str=str;
+	snt->nfields=nfields;
+	snt->type=sentence_type(str+1,snt->fields[0].len);
+	return NMEA_SUCCESS;
+}
+
+/* Convert the fields of a parsed sentence of a supported type */
+int nmea_decode(const struct nmea_sentence * snt, struct nmea_data * data){
+	if (snt->type == NMEA_TYPE_UNKNOWN){
+		return NMEA_ERR_TYPE;
+	}
+	const struct nmea_type * t=&nmea_types[snt->type-1];
+	if (snt->nfields < t->minfields){
+		return NMEA_ERR_FIELDS;
+	}
+	memset(data,0,sizeof(*data));
+	data->type=snt->type;
+	return t->decode(snt,data);
+}
+
+/* field helpers: these return 1 when the field holds a value, 0 when it is empty and NMEA_ERR_FIELDS
+ * when it is malformed */
+
+/* decimal number with up to ndec decimals (more are truncated), scaled by 10^ndec */
+static int field_fixed(const struct nmea_sentence * snt, int i, int ndec, int64_t * val){
+	size_t len=nmea_field_len(snt,i);
+	const char * p=nmea_field_ptr(snt,i);
+	const char * end=p+len;
+	bool negative=false;
+	int64_t v=0;
+	int ndigits=0;
+
+	if (len == 0){
+		return 0;
+	}
+	if (*p == '-'){
+		negative=true;
+		p++;
+	}
+	for (;p < end && *p != '.';p++){
+		if (*p < '0' || *p > '9' || ndigits++ >= 12){
+			return NMEA_ERR_FIELDS;
+		}
+		v=v*10+(*p-'0');
+	}
+	if (p < end){
+		p++;
+	}
+	for (int d=0;d<ndec;d++){
+		int digit=0;
+		if (p < end){
+			if (*p < '0' || *p > '9'){
+				return NMEA_ERR_FIELDS;
+			}
+			digit=*p++-'0';
+		}
+		v=v*10+digit;
+	}
+	for (;p < end;p++){
+		if (*p < '0' || *p > '9'){
+			return NMEA_ERR_FIELDS;
+		}
+	}
+	if (ndigits == 0 && ndec == 0){
+		return NMEA_ERR_FIELDS;
+	}
+	*val=negative ? -v : v;
+	return 1;
+}
+
+/* integer, which becomes -1 when the field is empty */
+static int field_int(const struct nmea_sentence * snt, int i, int32_t max, int32_t * val){
+	int64_t v=-1;
+	int stat=field_fixed(snt,i,0,&v);
+	if (stat < 0 || v > max){
+		return NMEA_ERR_FIELDS;
+	}
+	*val=(int32_t)v;
+	return stat;
+}
+
+/* time of day (hhmmss.sss) in milliseconds */
+static int field_time(const struct nmea_sentence * snt, int i, uint32_t * ms){
+	int64_t v;
+	int stat=field_fixed(snt,i,3,&v);
+	if (stat <= 0){
+		return stat;
+	}
+	int64_t hhmmss=v/1000;
+	int hours=hhmmss/10000;
+	int minutes=(hhmmss/100)%100;
+	int seconds=hhmmss%100;
+	if (v < 0 || hours > 23 || minutes > 59 || seconds > 60){
+		return NMEA_ERR_FIELDS;
+	}
+	*ms=(uint32_t)((hours*3600+minutes*60+seconds)*1000+v%1000);
+	return 1;
+}
+
+/* latitude or longitude ([d]ddmm.mmmm plus hemisphere) in 1e-7 degrees */
+static int field_coordinate(const struct nmea_sentence * snt, int i, char negative, int32_t * val){
+	int64_t v;
+	int stat=field_fixed(snt,i,5,&v);
+	if (stat <= 0){
+		*val=0;
+		return stat;
+	}
+	if (v < 0 || nmea_field_len(snt,i+1) != 1){
+		return NMEA_ERR_FIELDS;
+	}
+	/* v holds the minutes in units of 1e-5 */
+	int64_t degrees=v/10000000;
+	int64_t minutes=v%10000000;
+	if (minutes >= 6000000 || degrees > 180){
+		return NMEA_ERR_FIELDS;
+	}
+	int64_t e7=degrees*10000000+(minutes*100+30)/60;
+	*val=(int32_t)((*nmea_field_ptr(snt,i+1) == negative) ? -e7 : e7);
+	return 1;
+}
+
+static int decode_gsv(const struct nmea_sentence * snt, struct nmea_data * data){
+	struct nmea_gsv * gsv=&data->gsv;
+	int32_t v[3];
+
+	if (field_int(snt,1,9,&v[0]) != 1 || field_int(snt,2,9,&v[1]) != 1 || field_int(snt,3,99,&v[2]) != 1){
+		return NMEA_ERR_FIELDS;
+	}
+	gsv->nmsgs=v[0];
+	gsv->msgnum=v[1];
+	gsv->nsats=v[2];
+
+	/* four fields per satellite (NMEA 4.10 appends a signal id, which makes the count odd) */
+	int nentries=(snt->nfields-4)/4;
+	for (int k=0;k<nentries && k<NMEA_GSV_MAXSATS;k++){
+		struct nmea_gsv_sat * sat=&gsv->sats[gsv->nentries];
+		int32_t prn;
+		int32_t elev;
+		int32_t az;
+		int32_t snr;
+		int f=4+4*k;
+		int stat=field_int(snt,f,999,&prn);
+		if (stat < 0 || field_int(snt,f+1,90,&elev) < 0 || field_int(snt,f+2,359,&az) < 0 ||
+				field_int(snt,f+3,99,&snr) < 0){
+			return NMEA_ERR_FIELDS;
+		}
+		if (stat == 0){
+			continue;
+		}
+		sat->prn=prn;
+		sat->elevation=elev;
+		sat->azimuth=az;
+		sat->snr=snr;
+		gsv->nentries++;
+	}
+	return NMEA_SUCCESS;
+}
+
+static int decode_rmc(const struct nmea_sentence * snt, struct nmea_data * data){
+	struct nmea_rmc * rmc=&data->rmc;
+	int32_t date;
+
+	if (field_time(snt,1,&rmc->time) < 0 || nmea_field_len(snt,2) != 1 ||
+			field_coordinate(snt,3,'S',&rmc->latitude) < 0 || field_coordinate(snt,5,'W',&rmc->longitude) < 0 ||
+			field_int(snt,9,311299,&date) < 0){
+		return NMEA_ERR_FIELDS;
+	}
+	rmc->valid=(*nmea_field_ptr(snt,2) == 'A');
+	if (date >= 0){
+		rmc->day=date/10000;
+		rmc->month=(date/100)%100;
+		rmc->year=date%100;
+	}
+	return NMEA_SUCCESS;
+}
+
+static int decode_gga(const struct nmea_sentence * snt, struct nmea_data * data){
+	struct nmea_gga * gga=&data->gga;
+	int32_t quality;
+	int32_t nsats;
+	int64_t hdop=0;
+	int64_t alt=0;
+
+	if (field_time(snt,1,&gga->time) < 0 || field_coordinate(snt,2,'S',&gga->latitude) < 0 ||
+			field_coordinate(snt,4,'W',&gga->longitude) < 0 || field_int(snt,6,9,&quality) < 0 ||
+			field_int(snt,7,99,&nsats) < 0 || field_fixed(snt,8,2,&hdop) < 0 || field_fixed(snt,9,3,&alt) < 0 ||
+			hdop < 0 || hdop > UINT16_MAX || alt < INT32_MIN || alt > INT32_MAX){
+		return NMEA_ERR_FIELDS;
+	}
+	gga->quality=(quality > 0) ? quality : 0;
+	gga->nsats=(nsats > 0) ? nsats : 0;
+	gga->hdop=(uint16_t)hdop;
+	gga->altitude=(int32_t)alt;
+	return NMEA_SUCCESS;
+}
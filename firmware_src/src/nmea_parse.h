@@ -0,0 +1,111 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Validation and parsing of NMEA 0183 sentences without copying them. nmea_parse() checks the
+ * framing ($...*hh, optionally followed by CR LF) and the checksum in a single pass over the
+ * sentence and records where each field starts; the sentence itself is left untouched, so it can
+ * still be logged as it is. nmea_decode() then converts the fields of the supported sentence
+ * types (GSV, RMC and GGA) into numbers, using a table with a decoder per type.
+ */
+
+#ifndef NMEA_PARSE_H
+#define NMEA_PARSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define NMEA_SUCCESS 0
+#define NMEA_ERR_FORMAT -1 /* no valid $...*hh framing, invalid characters or too many fields */
+#define NMEA_ERR_CHECKSUM -2
+#define NMEA_ERR_TYPE -3 /* not a supported sentence type (nmea_decode only) */
+#define NMEA_ERR_FIELDS -4 /* too few or malformed fields (nmea_decode only) */
+
+/* longest sentence (from $ up to and including CR LF), as in the standard */
+#define NMEA_MAXLEN 82
+#define NMEA_MAXFIELDS 24
+
+/* sentence types which can be decoded */
+#define NMEA_TYPE_UNKNOWN 0
+#define NMEA_TYPE_GSV 1
+#define NMEA_TYPE_RMC 2
+#define NMEA_TYPE_GGA 3
+
+/* a field is a slice of the sentence */
+struct nmea_field {
+	uint8_t offset;
+	uint8_t len;
+};
+
+struct nmea_sentence {
+	const char * str;
+	uint8_t type; /* NMEA_TYPE_... (from the formatter, regardless of the talker) */
+	uint8_t nfields; /* including the address field (e.g. GPGSV) */
+	struct nmea_field fields[NMEA_MAXFIELDS];
+};
+
+/* satellites in view: up to 4 per sentence */
+#define NMEA_GSV_MAXSATS 4
+
+struct nmea_gsv_sat {
+	uint16_t prn;
+	int16_t elevation; /* degrees, -1 when empty */
+	int16_t azimuth; /* degrees, -1 when empty */
+	int16_t snr; /* dB-Hz, -1 when not tracked */
+};
+
+struct nmea_gsv {
+	uint8_t nmsgs;
+	uint8_t msgnum;
+	uint8_t nsats; /* satellites in view */
+	uint8_t nentries; /* satellites in this sentence */
+	struct nmea_gsv_sat sats[NMEA_GSV_MAXSATS];
+};
+
+/* time of day in milliseconds and position in 1e-7 degrees */
+struct nmea_rmc {
+	uint32_t time;
+	bool valid;
+	int32_t latitude;
+	int32_t longitude;
+	uint8_t day;
+	uint8_t month;
+	uint8_t year; /* two digits */
+};
+
+struct nmea_gga {
+	uint32_t time;
+	int32_t latitude;
+	int32_t longitude;
+	uint8_t quality;
+	uint8_t nsats;
+	uint16_t hdop; /* 0.01 */
+	int32_t altitude; /* mm */
+};
+
+struct nmea_data {
+	uint8_t type;
+	union {
+		struct nmea_gsv gsv;
+		struct nmea_rmc rmc;
+		struct nmea_gga gga;
+	};
+};
+
+int nmea_parse(const char * str, size_t len, struct nmea_sentence * snt);
+int nmea_decode(const struct nmea_sentence * snt, struct nmea_data * data);
+
+/* length of a field and a pointer to its first character */
+static inline size_t nmea_field_len(const struct nmea_sentence * snt, int i){
+	return (i < snt->nfields) ? snt->fields[i].len : 0;
+}
+
+static inline const char * nmea_field_ptr(const struct nmea_sentence * snt, int i){
+	return snt->str+snt->fields[i].offset;
+}
+
+#endif /* NMEA_PARSE_H */
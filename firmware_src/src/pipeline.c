@@ -0,0 +1,18 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "pipeline.h"
+
+struct pipeline_counters pipeline;
+
+/* copy the counters without the GNSS event handler changing them halfway */
+void pipeline_snapshot(struct pipeline_counters * snap){
+	unsigned int key=irq_lock();
+	memcpy(snap,&pipeline,sizeof(*snap));
+	irq_unlock(key);
+}
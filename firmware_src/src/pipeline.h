@@ -0,0 +1,45 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Counters of the GNSS data pipeline since boot: records (NMEA sentences or PVT records) from the
+ * modem, through the GNSS data ring, to the compressed log. Every counter is only incremented by
+ * one context (the GNSS event handler or the main thread), so plain 32 bit increments suffice;
+ * pipeline_snapshot() takes a consistent copy for the device status (and so for the JSON header
+ * of every log file). Subtracting the snapshots in the headers of consecutive files gives the
+ * losses per file, as long as the uptime increased in between.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+
+struct pipeline_counters {
+	/* GNSS event handler */
+	uint32_t received; /* NMEA sentences, or PVT frames with a fix in the PVT log mode */
+	uint32_t queued; /* records put in the GNSS data ring */
+	uint32_t dropped_read; /* events whose data could not be read from the modem */
+	uint32_t dropped_corrupt; /* NMEA sentences with a wrong checksum or framing */
+	uint32_t dropped_encode; /* PVT frames which could not be encoded */
+	uint32_t dropped_ring; /* records which did not fit in the GNSS data ring */
+	uint32_t deadline_missed; /* PVT notifications which were too late (backpressure on the modem) */
+	uint32_t window_blocked; /* PVT frames where GNSS was blocked by LTE activity */
+	/* main thread */
+	uint32_t dropped_nofix; /* records taken from the ring while there was no fix or open log file */
+	uint32_t dropped_filter; /* NMEA sentences removed by the NMEA filter */
+	uint32_t written; /* records written to the log */
+	uint32_t bytes_written; /* uncompressed bytes of these records */
+	uint32_t bytes_compressed; /* bytes written to the closed GNSS data logs */
+	uint32_t syncs; /* syncs of the closed GNSS data logs */
+	uint32_t writer_waits; /* times the closed GNSS data logs waited for the writer thread */
+};
+
+extern struct pipeline_counters pipeline;
+
+void pipeline_snapshot(struct pipeline_counters * snap);
+
+#endif /* PIPELINE_H */
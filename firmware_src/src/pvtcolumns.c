@@ -0,0 +1,258 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <string.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/byteorder.h>
+#include "pvtcolumns.h"
+
+BUILD_ASSERT(CONFIG_GNSSR_PVT_BLOCK_EPOCHS <= UINT8_MAX, "a PVT block holds at most 255 epochs");
+BUILD_ASSERT(CONFIG_GNSSR_PVT_BLOCK_EPOCHS*PVTREC_MAXSIZE <= UINT16_MAX, "PVT block buffer too large");
+
+/* small output buffer, so the encoded block can be written without holding all of it in memory */
+struct pvtcol_out {
+	lz4streamfile * lz4id;
+	uint8_t buf[64];
+	size_t n;
+	int stat;
+};
+
+static void out_flush(struct pvtcol_out * out){
+	if (out->n > 0 && out->stat == LZ4_SUCCESS){
+		out->stat=lz4write_n(out->lz4id,out->buf,out->n);
+	}
+	out->n=0;
+}
+
+static void out_byte(struct pvtcol_out * out, uint8_t byte){
+	if (out->n == sizeof(out->buf)){
+		out_flush(out);
+	}
+	out->buf[out->n++]=byte;
+}
+
+static void out_varint(struct pvtcol_out * out, uint32_t val){
+	while (val >= 0x80){
+		out_byte(out,(val & 0x7f) | 0x80);
+		val>>=7;
+	}
+	out_byte(out,val);
+}
+
+/* zigzag encoding, so small negative values stay small */
+static void out_zigzag(struct pvtcol_out * out, int32_t val){
+	out_varint(out,((uint32_t)val << 1) ^ (uint32_t)(val >> 31));
+}
+
+/* difference with the previous value of a column */
+static void out_delta(struct pvtcol_out * out, int32_t val, int32_t * prev){
+	out_zigzag(out,(int32_t)((uint32_t)val-(uint32_t)*prev));
+	*prev=val;
+}
+
+static void get_header(const struct pvtcolumns * pc, int epoch, struct pvtrec_header * hdr){
+	memcpy(hdr,&pc->buf[pc->offsets[epoch]],sizeof(*hdr));
+}
+
+static void get_sv(const struct pvtcolumns * pc, int epoch, int i, struct pvtrec_sv * sv){
+	memcpy(sv,&pc->buf[pc->offsets[epoch]+sizeof(struct pvtrec_header)+i*sizeof(*sv)],sizeof(*sv));
+}
+
+/* entry of a satellite in the record of an epoch (or -1) */
+static int find_sv(const struct pvtcolumns * pc, int epoch, const struct pvtcol_sat * sat){
+	struct pvtrec_header hdr;
+	struct pvtrec_sv sv;
+
+	get_header(pc,epoch,&hdr);
+	for (int i=0;i<hdr.nsv;i++){
+		get_sv(pc,epoch,i,&sv);
+		if (sys_le16_to_cpu(sv.sv) == sat->sv && sv.signal == sat->signal){
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool tracked(const struct pvtcol_sat * sat, int epoch){
+	return sat->epochs[epoch/8] & (1 << (epoch%8));
+}
+
+/* satellite table entry of a satellite which was not yet seen in the current epoch (or -1) */
+static int find_sat(const struct pvtcolumns * pc, const struct pvtrec_sv * sv){
+	for (int s=0;s<pc->nsats;s++){
+		const struct pvtcol_sat * sat=&pc->sats[s];
+		if (sat->sv == sys_le16_to_cpu(sv->sv) && sat->signal == sv->signal && !tracked(sat,pc->nepochs)){
+			return s;
+		}
+	}
+	return -1;
+}
+
+void pvtcol_init(struct pvtcolumns * pc){
+	pc->nbuf=0;
+	pc->nepochs=0;
+	pc->nsats=0;
+}
+
+/* Write the buffered epochs as one columnar block (preceded by an index mark) and start a new block */
+int pvtcol_flush(struct pvtcolumns * pc, lz4streamfile * lz4id){
+	struct pvtcol_out out={.lz4id=lz4id,.n=0,.stat=LZ4_SUCCESS};
+	struct pvtrec_header hdr;
+	struct pvtrec_sv sv;
+
+	if (pc->nepochs == 0){
+		return LZ4_SUCCESS;
+	}
+	get_header(pc,0,&hdr);
+	lz4mark(lz4id,sys_le32_to_cpu(hdr.utc));
+
+	out_byte(&out,PVTCOL_SYNC0);
+	out_byte(&out,PVTCOL_SYNC1);
+	out_byte(&out,PVTCOL_VERSION);
+	out_byte(&out,pc->nepochs);
+	out_byte(&out,pc->nsats);
+
+	/* epoch columns */
+	int32_t prev=0;
+	for (int e=0;e<pc->nepochs;e++){
+		get_header(pc,e,&hdr);
+		out_delta(&out,(int32_t)sys_le32_to_cpu(hdr.utc),&prev);
+	}
+	prev=0;
+	for (int e=0;e<pc->nepochs;e++){
+		get_header(pc,e,&hdr);
+		out_delta(&out,sys_le16_to_cpu(hdr.ms),&prev);
+	}
+	prev=0;
+	for (int e=0;e<pc->nepochs;e++){
+		get_header(pc,e,&hdr);
+		out_delta(&out,(int32_t)sys_le32_to_cpu(hdr.latitude),&prev);
+	}
+	prev=0;
+	for (int e=0;e<pc->nepochs;e++){
+		get_header(pc,e,&hdr);
+		out_delta(&out,(int32_t)sys_le32_to_cpu(hdr.longitude),&prev);
+	}
+	prev=0;
+	for (int e=0;e<pc->nepochs;e++){
+		get_header(pc,e,&hdr);
+		out_delta(&out,(int32_t)sys_le32_to_cpu(hdr.altitude),&prev);
+	}
+	prev=0;
+	for (int e=0;e<pc->nepochs;e++){
+		get_header(pc,e,&hdr);
+		out_delta(&out,sys_le16_to_cpu(hdr.accuracy),&prev);
+	}
+	uint8_t prevflags=0;
+	for (int e=0;e<pc->nepochs;e++){
+		get_header(pc,e,&hdr);
+		out_byte(&out,hdr.flags ^ prevflags);
+		prevflags=hdr.flags;
+	}
+
+	/* satellite table */
+	for (int s=0;s<pc->nsats;s++){
+		out_varint(&out,pc->sats[s].sv);
+		out_byte(&out,pc->sats[s].signal);
+		for (int i=0;i<(pc->nepochs+7)/8;i++){
+			out_byte(&out,pc->sats[s].epochs[i]);
+		}
+	}
+
+	/* satellite columns */
+	for (int s=0;s<pc->nsats;s++){
+		const struct pvtcol_sat * sat=&pc->sats[s];
+		int32_t prevcn0=0;
+		int32_t prevelev=0;
+		int32_t prevazim=0;
+		prevflags=0;
+		for (int col=0;col<4;col++){
+			for (int e=0;e<pc->nepochs;e++){
+				if (!tracked(sat,e)){
+					continue;
+				}
+				get_sv(pc,e,find_sv(pc,e,sat),&sv);
+				switch (col){
+					case 0:
+						out_delta(&out,sys_le16_to_cpu(sv.cn0),&prevcn0);
+						break;
+					case 1:
+						out_delta(&out,sv.elevation,&prevelev);
+						break;
+					case 2:
+						/* take the short way around the circle */
+						out_zigzag(&out,((sys_le16_to_cpu(sv.azimuth)-prevazim)%360+540)%360-180);
+						prevazim=sys_le16_to_cpu(sv.azimuth);
+						break;
+					default:
+						out_byte(&out,sv.flags ^ prevflags);
+						prevflags=sv.flags;
+						break;
+				}
+			}
+		}
+	}
+	out_flush(&out);
+	pvtcol_init(pc);
+	return out.stat;
+}
+
+/* Add a PVT record to the current block, the block is written once it holds CONFIG_GNSSR_PVT_BLOCK_EPOCHS epochs */
+int pvtcol_add(struct pvtcolumns * pc, const uint8_t * rec, size_t nrec, lz4streamfile * lz4id){
+	struct pvtrec_header hdr;
+	struct pvtrec_sv sv;
+	int stat=LZ4_SUCCESS;
+
+	if (nrec < sizeof(hdr) || nrec > PVTREC_MAXSIZE){
+		return LZ4_ERR_OVERSIZED;
+	}
+	memcpy(&hdr,rec,sizeof(hdr));
+	if (hdr.sync[0] != PVTREC_SYNC0 || hdr.sync[1] != PVTREC_SYNC1 || hdr.version != PVTREC_VERSION ||
+			nrec != sizeof(hdr)+hdr.nsv*sizeof(sv)){
+		return LZ4_ERR_COMPRESS;
+	}
+
+	/* start a new block when the satellites of this epoch don't fit in the table */
+	int nnew=0;
+	for (int i=0;i<hdr.nsv;i++){
+		memcpy(&sv,rec+sizeof(hdr)+i*sizeof(sv),sizeof(sv));
+		if (find_sat(pc,&sv) < 0){
+			nnew++;
+		}
+	}
+	if (pc->nsats+nnew > PVTCOL_MAXSATS){
+		stat=pvtcol_flush(pc,lz4id);
+	}
+
+	int epoch=pc->nepochs;
+	for (int i=0;i<hdr.nsv;i++){
+		memcpy(&sv,rec+sizeof(hdr)+i*sizeof(sv),sizeof(sv));
+		int s=find_sat(pc,&sv);
+		if (s < 0){
+			if (pc->nsats == PVTCOL_MAXSATS){
+				/* only possible when a satellite is listed twice in a record */
+				continue;
+			}
+			s=pc->nsats++;
+			pc->sats[s].sv=sys_le16_to_cpu(sv.sv);
+			pc->sats[s].signal=sv.signal;
+			memset(pc->sats[s].epochs,0,sizeof(pc->sats[s].epochs));
+		}
+		pc->sats[s].epochs[epoch/8]|=1 << (epoch%8);
+	}
+	pc->offsets[epoch]=pc->nbuf;
+	memcpy(&pc->buf[pc->nbuf],rec,nrec);
+	pc->nbuf+=nrec;
+	pc->nepochs++;
+
+	if (pc->nepochs == CONFIG_GNSSR_PVT_BLOCK_EPOCHS){
+		int flushstat=pvtcol_flush(pc,lz4id);
+		if (stat == LZ4_SUCCESS){
+			stat=flushstat;
+		}
+	}
+	return stat;
+}
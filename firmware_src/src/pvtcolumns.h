@@ -0,0 +1,59 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Columnar encoding of consecutive PVT records (see pvtrecord.h) before they are compressed.
+ * A block of up to CONFIG_GNSSR_PVT_BLOCK_EPOCHS epochs is transposed into columns (one per epoch
+ * field and per satellite field), in which each value is stored as the zigzag encoded difference
+ * with the previous value as a variable length integer. Slowly changing values such as elevation,
+ * azimuth and C/N0 then mostly become single, repeating bytes, which lz4 compresses very well.
+ *
+ * Block layout (version 1):
+ *   sync 0xA5 'C', version, number of epochs, number of satellites (all uint8)
+ *   epoch columns: utc, ms, latitude, longitude, altitude, accuracy (varint deltas), flags (xor)
+ *   satellite table: per satellite its number (varint), signal type (uint8) and a bitmap of the
+ *   epochs in which it was tracked (bit i%8 of byte i/8 for epoch i)
+ *   satellite columns: per satellite cn0, elevation, azimuth (varint deltas, azimuth wrapped to
+ *   -180..179 degrees) and flags (xor) over the epochs in which it was tracked
+ * Deltas of the first value are taken with respect to 0. Satellites appear in the order in which
+ * they were first seen in the block. debugtools/pvtdecode.py decodes the blocks.
+ */
+
+#ifndef PVTCOLUMNS_H
+#define PVTCOLUMNS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pvtrecord.h"
+#include "lz4file.h"
+
+#define PVTCOL_SYNC0 0xA5
+#define PVTCOL_SYNC1 'C'
+#define PVTCOL_VERSION 1
+/* maximum number of distinct satellites (and signals) in a block */
+#define PVTCOL_MAXSATS 64
+#define PVTCOL_BITMAPSIZE ((CONFIG_GNSSR_PVT_BLOCK_EPOCHS+7)/8)
+
+struct pvtcol_sat {
+	uint16_t sv;
+	uint8_t signal;
+	uint8_t epochs[PVTCOL_BITMAPSIZE]; /* epochs in which the satellite was tracked */
+};
+
+struct pvtcolumns {
+	uint8_t buf[CONFIG_GNSSR_PVT_BLOCK_EPOCHS*PVTREC_MAXSIZE]; /* records of the current block */
+	uint16_t offsets[CONFIG_GNSSR_PVT_BLOCK_EPOCHS]; /* start of each record in buf */
+	size_t nbuf;
+	uint8_t nepochs;
+	uint8_t nsats;
+	struct pvtcol_sat sats[PVTCOL_MAXSATS];
+};
+
+void pvtcol_init(struct pvtcolumns * pc);
+int pvtcol_add(struct pvtcolumns * pc, const uint8_t * rec, size_t nrec, lz4streamfile * lz4id);
+int pvtcol_flush(struct pvtcolumns * pc, lz4streamfile * lz4id);
+
+#endif /* PVTCOLUMNS_H */
@@ -0,0 +1,57 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <string.h>
+#include <math.h>
+#include <zephyr/sys/byteorder.h>
+#include "pvtrecord.h"
+
+/* Serialize a PVT frame (with utc its time in seconds since 1970) into buf. Only satellites which are
+ * tracked are stored. Returns the size of the record or 0 when buf is too small */
+size_t pvtrec_encode(const struct nrf_modem_gnss_pvt_data_frame * pvt, uint32_t utc, uint8_t * buf, size_t buflen){
+	struct pvtrec_header hdr;
+	size_t nrec=sizeof(hdr);
+	uint8_t nsv=0;
+
+	for (int i=0;i<NRF_MODEM_GNSS_MAX_SATELLITES;i++){
+		if (pvt->sv[i].sv == 0){
+			continue;
+		}
+		struct pvtrec_sv sv={
+			.sv=sys_cpu_to_le16(pvt->sv[i].sv),
+			.signal=pvt->sv[i].signal,
+			.cn0=sys_cpu_to_le16(pvt->sv[i].cn0),
+			.elevation=(int8_t)pvt->sv[i].elevation,
+			.azimuth=sys_cpu_to_le16((uint16_t)pvt->sv[i].azimuth),
+			.flags=pvt->sv[i].flags
+		};
+		if (nrec+sizeof(sv) > buflen){
+			return 0;
+		}
+		memcpy(buf+nrec,&sv,sizeof(sv));
+		nrec+=sizeof(sv);
+		nsv++;
+	}
+
+	if (sizeof(hdr) > buflen){
+		return 0;
+	}
+	float accuracy=roundf(pvt->accuracy*100.0f);
+	hdr.sync[0]=PVTREC_SYNC0;
+	hdr.sync[1]=PVTREC_SYNC1;
+	hdr.version=PVTREC_VERSION;
+	hdr.nsv=nsv;
+	hdr.utc=sys_cpu_to_le32(utc);
+	hdr.ms=sys_cpu_to_le16(pvt->datetime.ms);
+	hdr.flags=pvt->flags;
+	hdr.latitude=sys_cpu_to_le32((int32_t)lround(pvt->latitude*1e7));
+	hdr.longitude=sys_cpu_to_le32((int32_t)lround(pvt->longitude*1e7));
+	hdr.altitude=sys_cpu_to_le32((int32_t)lroundf(pvt->altitude*1000.0f));
+	hdr.accuracy=sys_cpu_to_le16((accuracy >= 0.0f && accuracy < UINT16_MAX) ? (uint16_t)accuracy : UINT16_MAX);
+	memcpy(buf,&hdr,sizeof(hdr));
+
+	return nrec;
+}
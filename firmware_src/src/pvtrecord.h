@@ -0,0 +1,52 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Compact binary records of the GNSS PVT solution and the tracked satellites, as an alternative to
+ * logging NMEA sentences. All fields are little endian. A record consists of a header followed by
+ * nsv satellite entries; new fields are only added in a new version of the record.
+ * debugtools/pvtdecode.py converts logged records back to tables.
+ */
+
+#ifndef PVTRECORD_H
+#define PVTRECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zephyr/toolchain.h>
+#include <nrf_modem_gnss.h>
+
+#define PVTREC_SYNC0 0xA5
+#define PVTREC_SYNC1 'P'
+#define PVTREC_VERSION 1
+
+struct pvtrec_header {
+	uint8_t sync[2];
+	uint8_t version;
+	uint8_t nsv; /* number of satellite entries which follow */
+	uint32_t utc; /* unix time [s] */
+	uint16_t ms;
+	uint8_t flags; /* PVT flags (NRF_MODEM_GNSS_PVT_FLAG_*) */
+	int32_t latitude; /* [1e-7 deg] */
+	int32_t longitude; /* [1e-7 deg] */
+	int32_t altitude; /* [mm] */
+	uint16_t accuracy; /* [cm], 65535 when larger */
+} __packed;
+
+struct pvtrec_sv {
+	uint16_t sv; /* satellite number (PRN) */
+	uint8_t signal; /* signal type (NRF_MODEM_GNSS_SV_TYPE_*) */
+	uint16_t cn0; /* carrier to noise density [0.1 dB-Hz] */
+	int8_t elevation; /* [deg] */
+	uint16_t azimuth; /* [deg] */
+	uint8_t flags; /* satellite flags (NRF_MODEM_GNSS_SV_FLAG_*) */
+} __packed;
+
+#define PVTREC_MAXSIZE (sizeof(struct pvtrec_header)+NRF_MODEM_GNSS_MAX_SATELLITES*sizeof(struct pvtrec_sv))
+
+size_t pvtrec_encode(const struct nrf_modem_gnss_pvt_data_frame * pvt, uint32_t utc, uint8_t * buf, size_t buflen);
+
+#endif /* PVTRECORD_H */
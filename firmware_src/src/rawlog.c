@@ -0,0 +1,292 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <zephyr/kernel.h>
+#include <zephyr/storage/disk_access.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include <stddef.h>
+#include <string.h>
+#include "rawlog.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(GNSSR,CONFIG_GNSSR_LOG_LEVEL);
+
+/* the headers are written as they are in memory */
+BUILD_ASSERT(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "rawlog sectors are little endian");
+BUILD_ASSERT(sizeof(struct rawlog_sector) == RAWLOG_SECTOR_SIZE, "rawlog sectors fill a sector");
+
+/* partition table of the MBR */
+#define MBR_PARTITIONS 446
+#define MBR_ENTRY_SIZE 16
+#define MBR_SIGNATURE 510
+
+/* sectors to look further when a probed sector is not valid (e.g. after a torn write) */
+#define RAWLOG_MAX_PROBE 16
+
+static struct {
+	const char * disk;
+	uint32_t start;
+	uint32_t nsectors;
+	uint32_t next;
+	uint32_t nwrites;
+	bool mounted;
+} rawlog;
+
+K_MUTEX_DEFINE(rawlog_lock);
+
+static struct rawlog_sector probebuf;
+
+static uint32_t sector_crc(const struct rawlog_sector * sct){
+	uint32_t crc=crc32_ieee((const uint8_t *)&sct->hdr,offsetof(struct rawlog_header,crc));
+	return crc32_ieee_update(crc,sct->payload,sct->hdr.nbytes);
+}
+
+/* a sector which was written at position pos of the ring */
+static bool sector_valid(const struct rawlog_sector * sct, uint32_t pos){
+	return sct->hdr.magic == RAWLOG_MAGIC && sct->hdr.nbytes <= RAWLOG_PAYLOAD &&
+		sct->hdr.seq%rawlog.nsectors == pos && sct->hdr.crc == sector_crc(sct);
+}
+
+/* sequence number of the first valid sector at or shortly after pos */
+static bool probe(uint32_t pos, uint32_t * seq){
+	for (uint32_t i=pos;i<rawlog.nsectors && i<pos+RAWLOG_MAX_PROBE;i++){
+		if (disk_access_read(rawlog.disk,(uint8_t *)&probebuf,rawlog.start+i,1) != 0){
+			return false;
+		}
+		if (sector_valid(&probebuf,i)){
+			*seq=probebuf.hdr.seq;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* find the raw partition in the MBR and the head of the ring in it */
+int rawlog_mount(const char * disk){
+	const uint8_t * mbr=(const uint8_t *)&probebuf;
+
+	rawlog.mounted=false;
+	if (disk_access_read(disk,(uint8_t *)&probebuf,0,1) != 0){
+		return RAWLOG_ERR_IO;
+	}
+	if (mbr[MBR_SIGNATURE] != 0x55 || mbr[MBR_SIGNATURE+1] != 0xAA){
+		return RAWLOG_ERR_NOPART;
+	}
+	rawlog.nsectors=0;
+	for (int i=0;i<4;i++){
+		const uint8_t * entry=mbr+MBR_PARTITIONS+i*MBR_ENTRY_SIZE;
+		if (entry[4] == RAWLOG_PART_TYPE){
+			rawlog.start=sys_get_le32(entry+8);
+			rawlog.nsectors=sys_get_le32(entry+12);
+			break;
+		}
+	}
+	if (rawlog.nsectors < CONFIG_GNSSR_RAWLOG_BUFFER_SECTORS){
+		return RAWLOG_ERR_NOPART;
+	}
+	rawlog.disk=disk;
+
+	/* the sectors from the start of the ring up to the head were written in the lap of the first
+	 * sector, the ones after it in the previous lap (or not at all) */
+	uint32_t seq0;
+	if (!probe(0,&seq0)){
+		/* empty partition: start in the second lap, so that no file gets number 0 */
+		rawlog.next=rawlog.nsectors;
+	}else{
+		uint32_t lap=seq0/rawlog.nsectors;
+		uint32_t lo=0;
+		uint32_t hi=rawlog.nsectors;
+		while (hi-lo > 1){
+			uint32_t mid=lo+(hi-lo)/2;
+			uint32_t seq;
+			if (probe(mid,&seq) && seq/rawlog.nsectors >= lap){
+				lo=mid;
+			}else{
+				hi=mid;
+			}
+		}
+		rawlog.next=lap*rawlog.nsectors+lo+1;
+	}
+	rawlog.nwrites=0;
+	rawlog.mounted=true;
+	LOG_INF("Raw log partition of %u sectors at sector %u, next sector %u (lap %u)",rawlog.nsectors,rawlog.start,
+			rawlog.next%rawlog.nsectors,rawlog.next/rawlog.nsectors);
+	return RAWLOG_SUCCESS;
+}
+
+bool rawlog_mounted(void){
+	return rawlog.mounted;
+}
+
+void rawlog_get_status(struct rawlog_status * status){
+	k_mutex_lock(&rawlog_lock,K_FOREVER);
+	status->start=rawlog.start;
+	status->nsectors=rawlog.nsectors;
+	status->next=rawlog.next;
+	status->nwrites=rawlog.nwrites;
+	k_mutex_unlock(&rawlog_lock);
+}
+
+/* write count consecutive sectors, starting with sequence number seq, in as few commands as possible */
+static int write_ring(const struct rawlog_sector * sct, uint32_t seq, uint32_t count){
+	while (count > 0){
+		uint32_t pos=seq%rawlog.nsectors;
+		uint32_t n=MIN(count,rawlog.nsectors-pos);
+		if (disk_access_write(rawlog.disk,(const uint8_t *)sct,rawlog.start+pos,n) != 0){
+			LOG_ERR("Cannot write %u sectors to the raw log partition",n);
+			return RAWLOG_ERR_IO;
+		}
+		rawlog.nwrites++;
+		sct+=n;
+		seq+=n;
+		count-=n;
+	}
+	return RAWLOG_SUCCESS;
+}
+
+static void seal(struct rawlog_sector * sct, uint32_t seq, uint32_t file, uint32_t index){
+	sct->hdr.magic=RAWLOG_MAGIC;
+	sct->hdr.seq=seq;
+	sct->hdr.file=file;
+	sct->hdr.index=index;
+	sct->hdr.reserved=0;
+	sct->hdr.crc=sector_crc(sct);
+}
+
+/* Write the buffered sectors. The incomplete last sector is kept in the buffer to be written again,
+ * unless the file is closed (flags RAWLOG_LAST) */
+static int rawlog_flush(struct rawlog_file * rf, uint8_t flags){
+	uint32_t nsect=rf->cur+((rf->sectors[rf->cur].hdr.nbytes > 0) ? 1 : 0);
+	uint32_t first=0;
+	int stat=RAWLOG_SUCCESS;
+
+	if (nsect == 0){
+		return RAWLOG_SUCCESS;
+	}
+	rf->sectors[nsect-1].hdr.flags|=flags;
+
+	k_mutex_lock(&rawlog_lock,K_FOREVER);
+	if (rf->rewrite && rawlog.next-rf->curseq >= rawlog.nsectors){
+		/* the ring went round since then, its place has been taken */
+		rf->rewrite=false;
+	}
+	if (rf->rewrite){
+		/* the sector which was incomplete at the previous sync keeps its place */
+		seal(&rf->sectors[0],rf->curseq,rf->file,rf->index);
+		stat=write_ring(&rf->sectors[0],rf->curseq,1);
+		first=1;
+	}
+	uint32_t seq=rawlog.next;
+	rawlog.next+=nsect-first;
+	if (rf->file == 0){
+		rf->file=seq;
+	}
+	for (uint32_t i=first;i<nsect;i++){
+		seal(&rf->sectors[i],seq+i-first,rf->file,rf->index+i);
+	}
+	if (stat == RAWLOG_SUCCESS && nsect > first){
+		stat=write_ring(&rf->sectors[first],seq,nsect-first);
+	}
+	k_mutex_unlock(&rawlog_lock);
+
+	struct rawlog_sector * last=&rf->sectors[nsect-1];
+	if (last->hdr.nbytes < RAWLOG_PAYLOAD && !(flags & RAWLOG_LAST)){
+		if (last != &rf->sectors[0]){
+			memcpy(&rf->sectors[0],last,sizeof(*last));
+		}
+		rf->curseq=rf->sectors[0].hdr.seq;
+		rf->index+=nsect-1;
+		rf->rewrite=true;
+	}else{
+		rf->sectors[0].hdr.nbytes=0;
+		rf->sectors[0].hdr.flags=0;
+		rf->index+=nsect;
+		rf->rewrite=false;
+	}
+	rf->cur=0;
+	return stat;
+}
+
+static int rawlog_open(void * ctx, const char * path){
+	struct rawlog_file * rf=ctx;
+
+	if (!rawlog.mounted){
+		return RAWLOG_ERR_NOTMOUNTED;
+	}
+	const char * name=strrchr(path,'/');
+	name=(name != NULL) ? name+1 : path;
+	strncpy(rf->name,name,sizeof(rf->name)-1);
+	rf->name[sizeof(rf->name)-1]='\0';
+
+	rf->cur=0;
+	rf->file=0;
+	rf->index=0;
+	rf->rewrite=false;
+	/* the first sector starts with the file name */
+	struct rawlog_sector * sct=&rf->sectors[0];
+	sct->hdr.flags=RAWLOG_FIRST;
+	sct->hdr.nbytes=strlen(rf->name)+1;
+	memcpy(sct->payload,rf->name,sct->hdr.nbytes);
+	rf->isOpen=true;
+	return RAWLOG_SUCCESS;
+}
+
+static int rawlog_write(void * ctx, const void * buf, size_t nbuf){
+	struct rawlog_file * rf=ctx;
+	const uint8_t * src=buf;
+
+	while (nbuf > 0){
+		struct rawlog_sector * sct=&rf->sectors[rf->cur];
+		if (sct->hdr.nbytes == RAWLOG_PAYLOAD){
+			/* the buffer is only written when more data follows, so the last sector can still be flagged */
+			if (rf->cur == CONFIG_GNSSR_RAWLOG_BUFFER_SECTORS-1){
+				if (rawlog_flush(rf,0) != RAWLOG_SUCCESS){
+					return RAWLOG_ERR_IO;
+				}
+			}else{
+				rf->cur++;
+				rf->sectors[rf->cur].hdr.nbytes=0;
+				rf->sectors[rf->cur].hdr.flags=0;
+			}
+			continue;
+		}
+		size_t ncopy=MIN(nbuf,RAWLOG_PAYLOAD-sct->hdr.nbytes);
+		memcpy(sct->payload+sct->hdr.nbytes,src,ncopy);
+		sct->hdr.nbytes+=ncopy;
+		src+=ncopy;
+		nbuf-=ncopy;
+	}
+	return RAWLOG_SUCCESS;
+}
+
+static int rawlog_sync(void * ctx){
+	struct rawlog_file * rf=ctx;
+	if (rawlog_flush(rf,0) != RAWLOG_SUCCESS){
+		return RAWLOG_ERR_IO;
+	}
+	return (disk_access_ioctl(rawlog.disk,DISK_IOCTL_CTRL_SYNC,NULL) == 0) ? RAWLOG_SUCCESS : RAWLOG_ERR_IO;
+}
+
+static int rawlog_close(void * ctx){
+	struct rawlog_file * rf=ctx;
+	int stat=rawlog_flush(rf,RAWLOG_LAST);
+	if (disk_access_ioctl(rawlog.disk,DISK_IOCTL_CTRL_SYNC,NULL) != 0){
+		stat=RAWLOG_ERR_IO;
+	}
+	rf->isOpen=false;
+	return stat;
+}
+
+const lz4sink * rawlog_sink(struct rawlog_file * rf){
+	rf->sink.open=rawlog_open;
+	rf->sink.write=rawlog_write;
+	rf->sink.sync=rawlog_sync;
+	rf->sink.close=rawlog_close;
+	rf->sink.ctx=rf;
+	rf->isOpen=false;
+	return &rf->sink;
+}
@@ -0,0 +1,90 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Log structured storage of the log files on a raw partition of the sdcard (CONFIG_GNSSR_RAWLOG),
+ * which avoids the updates of the FAT, directory entries and renames for every sync of a log file.
+ * The partition is the first one of type 0xDA ("non-FS data") in the MBR of the card, next to the
+ * FAT partition which still holds the configuration.
+ *
+ * The partition is used as a ring of 512 byte sectors, each holding a header and up to
+ * RAWLOG_PAYLOAD bytes of one file. Sectors are numbered by an ever increasing sequence number,
+ * which also determines their place in the ring (seq modulo the number of sectors), so the oldest
+ * data is overwritten once the ring is full. A file is identified by the sequence number of its
+ * first sector, whose payload starts with the (NUL terminated) file name. The sectors of a file are
+ * numbered as well, so that gaps show up, and the last sector of a closed file is flagged. When mounting, the head of the ring is found with a binary search on the
+ * sequence numbers; appending only writes at the head. A sync also writes the incomplete last
+ * sector of a file, which is written again (with the same sequence number) when more data follows.
+ *
+ * debugtools/rawlog_extract.py rebuilds the .lz4 files from an image of the card.
+ */
+
+#ifndef RAWLOG_H
+#define RAWLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/toolchain.h>
+#include "lz4file.h"
+
+#define RAWLOG_SUCCESS 0
+#define RAWLOG_ERR_IO -1
+#define RAWLOG_ERR_NOPART -2
+#define RAWLOG_ERR_NOTMOUNTED -3
+
+#define RAWLOG_PART_TYPE 0xDA
+#define RAWLOG_SECTOR_SIZE 512
+#define RAWLOG_MAGIC 0x31474c52 /* "RLG1" */
+
+/* flags of a sector */
+#define RAWLOG_FIRST 0x01 /* first sector of a file, the payload starts with its name */
+#define RAWLOG_LAST 0x02 /* last sector of a closed file */
+
+struct rawlog_header {
+	uint32_t magic;
+	uint32_t seq; /* sequence number of the sector */
+	uint32_t file; /* sequence number of the first sector of the file */
+	uint32_t index; /* number of the sector within the file */
+	uint16_t nbytes; /* bytes of payload */
+	uint8_t flags;
+	uint8_t reserved;
+	uint32_t crc; /* crc32 (IEEE) of the header up to here and the payload */
+} __packed;
+
+#define RAWLOG_PAYLOAD (RAWLOG_SECTOR_SIZE-sizeof(struct rawlog_header))
+
+struct rawlog_sector {
+	struct rawlog_header hdr;
+	uint8_t payload[RAWLOG_PAYLOAD];
+} __packed;
+
+/* a file being written to the raw partition, with a buffer of sectors which are written together */
+struct rawlog_file {
+	lz4sink sink;
+	struct rawlog_sector sectors[CONFIG_GNSSR_RAWLOG_BUFFER_SECTORS];
+	int cur; /* sector being filled */
+	uint32_t file; /* 0 until the first sector is written */
+	uint32_t curseq; /* sequence number of sectors[0] when it was already written (incomplete) */
+	uint32_t index; /* number of sectors[0] within the file */
+	bool rewrite;
+	bool isOpen;
+	char name[64];
+};
+
+struct rawlog_status {
+	uint32_t start; /* first sector of the partition */
+	uint32_t nsectors;
+	uint32_t next; /* sequence number of the next sector to write */
+	uint32_t nwrites; /* write commands since mounting */
+};
+
+int rawlog_mount(const char * disk);
+bool rawlog_mounted(void);
+void rawlog_get_status(struct rawlog_status * status);
+/* sink for an lz4 stream (see lz4setsink) which writes its file to the raw partition */
+const lz4sink * rawlog_sink(struct rawlog_file * rf);
+
+#endif /* RAWLOG_H */
@@ -0,0 +1,174 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <zephyr/sys/byteorder.h>
+#include "snrarc.h"
+
+/* elevation change [deg] against the direction of an arc which marks the turning point */
+#define SNRARC_TURN_ELEV 2
+
+void snrarc_init(struct snrarc_builder * b, snrarc_complete_t complete, void * ctx){
+	b->complete=complete;
+	b->ctx=ctx;
+	b->ncompleted=0;
+	b->nshort=0;
+	for (int i=0;i<CONFIG_GNSSR_ARC_TRACKS;i++){
+		b->tracks[i].npoints=0;
+	}
+}
+
+static struct snrarc_track * find_track(struct snrarc_builder * b, uint16_t sv, uint8_t signal){
+	for (int i=0;i<CONFIG_GNSSR_ARC_TRACKS;i++){
+		struct snrarc_track * tr=&b->tracks[i];
+		if (tr->npoints > 0 && tr->sv == sv && tr->signal == signal){
+			return tr;
+		}
+	}
+	return NULL;
+}
+
+static struct snrarc_track * free_track(struct snrarc_builder * b){
+	for (int i=0;i<CONFIG_GNSSR_ARC_TRACKS;i++){
+		if (b->tracks[i].npoints == 0){
+			return &b->tracks[i];
+		}
+	}
+	return NULL;
+}
+
+static void add_point(struct snrarc_track * tr, const struct snrarc_sample * sv, uint32_t utc){
+	struct snrarc_point * pt=&tr->points[tr->npoints++];
+	pt->t=sys_cpu_to_le16(utc-tr->utc0);
+	pt->elevation=sv->elevation;
+	pt->cn0=sys_cpu_to_le16(sv->cn0);
+	tr->azimuth1=sv->azimuth;
+	tr->last_sample=utc;
+}
+
+static void start_arc(struct snrarc_track * tr, const struct snrarc_sample * sv, uint32_t utc, int8_t direction){
+	tr->sv=sv->sv;
+	tr->signal=sv->signal;
+	tr->direction=direction;
+	tr->elev_ext=sv->elevation;
+	tr->npoints=0;
+	tr->azimuth0=sv->azimuth;
+	tr->utc0=utc;
+	add_point(tr,sv,utc);
+}
+
+/* pass an arc on and free its track */
+static void complete_arc(struct snrarc_builder * b, struct snrarc_track * tr, uint8_t flags){
+	if (tr->npoints < CONFIG_GNSSR_ARC_MIN_POINTS){
+		b->nshort++;
+		tr->npoints=0;
+		return;
+	}
+	if (tr->direction > 0){
+		flags|=SNRARC_RISING;
+	}else if (tr->direction < 0){
+		flags|=SNRARC_SETTING;
+	}
+	struct snrarc_header hdr={
+		.sync={SNRARC_SYNC0,SNRARC_SYNC1},
+		.version=SNRARC_VERSION,
+		.flags=flags,
+		.sv=sys_cpu_to_le16(tr->sv),
+		.signal=tr->signal,
+		.npoints=sys_cpu_to_le16(tr->npoints),
+		.utc=sys_cpu_to_le32(tr->utc0),
+		.azimuth0=sys_cpu_to_le16(tr->azimuth0),
+		.azimuth1=sys_cpu_to_le16(tr->azimuth1),
+	};
+	size_t npoints=tr->npoints*sizeof(struct snrarc_point);
+	memcpy(b->rec,&hdr,sizeof(hdr));
+	memcpy(b->rec+sizeof(hdr),tr->points,npoints);
+	b->complete(b->rec,sizeof(hdr)+npoints,b->ctx);
+	b->ncompleted++;
+	tr->npoints=0;
+}
+
+/* add a sample to the arc of a satellite, or complete the arc when the satellite turned or the arc is full */
+static void sample_arc(struct snrarc_builder * b, struct snrarc_track * tr, const struct snrarc_sample * sv, uint32_t utc){
+	int elev=sv->elevation;
+
+	if (tr->direction == 0 && elev != tr->elev_ext){
+		tr->direction=(elev > tr->elev_ext) ? 1 : -1;
+	}
+	if (tr->direction*(elev-tr->elev_ext) > 0){
+		tr->elev_ext=elev;
+	}else if (abs(elev-tr->elev_ext) >= SNRARC_TURN_ELEV){
+		/* the satellite passed its highest (or lowest) point within the window */
+		int8_t direction=-tr->direction;
+		complete_arc(b,tr,0);
+		start_arc(tr,sv,utc,direction);
+		return;
+	}
+
+	if (tr->npoints == CONFIG_GNSSR_ARC_MAX_POINTS || utc-tr->utc0 > UINT16_MAX){
+		int8_t direction=tr->direction;
+		complete_arc(b,tr,SNRARC_CONTINUED);
+		start_arc(tr,sv,utc,direction);
+		return;
+	}
+	add_point(tr,sv,utc);
+}
+
+/* Copy the tracked satellites of a PVT solution (utc is the time of the solution in seconds since
+ * 1970) into an epoch. Returns the number of bytes of the epoch to queue */
+size_t snrarc_pack(const struct nrf_modem_gnss_pvt_data_frame * pvt, uint32_t utc, struct snrarc_epoch * epoch){
+	int n=0;
+	for (int i=0;i<NRF_MODEM_GNSS_MAX_SATELLITES;i++){
+		const struct nrf_modem_gnss_sv * sv=&pvt->sv[i];
+		if (sv->sv == 0){
+			continue;
+		}
+		epoch->sv[n].sv=sv->sv;
+		epoch->sv[n].signal=sv->signal;
+		epoch->sv[n].elevation=sv->elevation;
+		epoch->sv[n].azimuth=sv->azimuth;
+		epoch->sv[n].cn0=sv->cn0;
+		n++;
+	}
+	epoch->utc=utc;
+	epoch->nsv=n;
+	return SNRARC_EPOCH_SIZE(n);
+}
+
+/* Process the satellites of an epoch, passing on the arcs which are completed by it */
+void snrarc_update(struct snrarc_builder * b, const struct snrarc_epoch * epoch){
+	uint32_t utc=epoch->utc;
+
+	/* arcs of satellites which were not tracked for a while */
+	for (int i=0;i<CONFIG_GNSSR_ARC_TRACKS;i++){
+		struct snrarc_track * tr=&b->tracks[i];
+		if (tr->npoints > 0 && utc-tr->last_seen > CONFIG_GNSSR_ARC_MAX_GAP){
+			complete_arc(b,tr,0);
+		}
+	}
+
+	for (int i=0;i<epoch->nsv && i < NRF_MODEM_GNSS_MAX_SATELLITES;i++){
+		const struct snrarc_sample * sv=&epoch->sv[i];
+		struct snrarc_track * tr=find_track(b,sv->sv,sv->signal);
+		if (sv->elevation < CONFIG_GNSS_MIN_ELEV || sv->elevation > CONFIG_GNSSR_ARC_MAX_ELEV){
+			if (tr != NULL){
+				complete_arc(b,tr,0);
+			}
+			continue;
+		}
+		if (tr == NULL){
+			tr=free_track(b);
+			if (tr == NULL){
+				continue;
+			}
+			start_arc(tr,sv,utc,0);
+		}else if (utc-tr->last_sample >= CONFIG_GNSSR_ARC_INTERVAL){
+			sample_arc(b,tr,sv,utc);
+		}
+		tr->last_seen=utc;
+	}
+}
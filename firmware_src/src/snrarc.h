@@ -0,0 +1,106 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Extraction of SNR arcs for GNSS interferometric reflectometry. Each satellite (and signal) is
+ * followed while its elevation is between CONFIG_GNSS_MIN_ELEV and CONFIG_GNSSR_ARC_MAX_ELEV, and
+ * its C/N0 is sampled every CONFIG_GNSSR_ARC_INTERVAL seconds. An arc ends when the satellite leaves
+ * the elevation window, is not tracked for more than CONFIG_GNSSR_ARC_MAX_GAP seconds, turns (a
+ * rising satellite which starts to set) or when the arc is full. A completed arc is passed to a
+ * callback as one record:
+ *   struct snrarc_header, followed by npoints times struct snrarc_point (little endian)
+ * Arcs with less than CONFIG_GNSSR_ARC_MIN_POINTS points are discarded.
+ *
+ * The GNSS event handler only packs the satellites of a PVT solution into a compact epoch
+ * (snrarc_pack) for a ring buffer; the arcs are built from the epochs in a thread (snrarc_update).
+ */
+
+#ifndef SNRARC_H
+#define SNRARC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zephyr/toolchain.h>
+#include <nrf_modem_gnss.h>
+
+#define SNRARC_SYNC0 0xA5
+#define SNRARC_SYNC1 'A'
+#define SNRARC_VERSION 1
+
+/* flags of an arc */
+#define SNRARC_RISING 0x01
+#define SNRARC_SETTING 0x02
+#define SNRARC_CONTINUED 0x04 /* the arc was full, the next arc of the satellite continues it */
+
+struct snrarc_header {
+	uint8_t sync[2];
+	uint8_t version;
+	uint8_t flags;
+	uint16_t sv;
+	uint8_t signal;
+	uint16_t npoints;
+	uint32_t utc; /* start of the arc, seconds since 1970 */
+	uint16_t azimuth0; /* degrees, at the start of the arc */
+	uint16_t azimuth1; /* degrees, at the end of the arc */
+} __packed;
+
+struct snrarc_point {
+	uint16_t t; /* seconds since the start of the arc */
+	uint8_t elevation; /* degrees */
+	uint16_t cn0; /* 0.1 dB-Hz */
+} __packed;
+
+#define SNRARC_MAXSIZE (sizeof(struct snrarc_header)+CONFIG_GNSSR_ARC_MAX_POINTS*sizeof(struct snrarc_point))
+
+/* a satellite of a PVT solution (host byte order) */
+struct snrarc_sample {
+	uint16_t sv;
+	uint8_t signal;
+	int8_t elevation; /* degrees */
+	uint16_t azimuth; /* degrees */
+	uint16_t cn0; /* 0.1 dB-Hz */
+} __packed;
+
+/* the tracked satellites of a PVT solution, of which only the first nsv are queued */
+struct snrarc_epoch {
+	uint32_t utc; /* seconds since 1970 */
+	uint8_t nsv;
+	struct snrarc_sample sv[NRF_MODEM_GNSS_MAX_SATELLITES];
+} __packed;
+
+#define SNRARC_EPOCH_SIZE(nsv) (offsetof(struct snrarc_epoch,sv)+(nsv)*sizeof(struct snrarc_sample))
+
+/* receives a completed arc record */
+typedef void (*snrarc_complete_t)(const uint8_t * arc, size_t narc, void * ctx);
+
+struct snrarc_track {
+	uint16_t sv;
+	uint8_t signal;
+	int8_t direction; /* 1 rising, -1 setting, 0 not yet known */
+	uint8_t elev_ext; /* highest (rising) or lowest (setting) elevation so far */
+	uint16_t npoints; /* 0 when the track is free */
+	uint16_t azimuth0;
+	uint16_t azimuth1;
+	uint32_t utc0;
+	uint32_t last_sample;
+	uint32_t last_seen;
+	struct snrarc_point points[CONFIG_GNSSR_ARC_MAX_POINTS]; /* already in little endian */
+};
+
+struct snrarc_builder {
+	snrarc_complete_t complete;
+	void * ctx; /* passed to complete */
+	uint32_t ncompleted; /* arcs passed to complete */
+	uint32_t nshort; /* arcs discarded for having too few points */
+	struct snrarc_track tracks[CONFIG_GNSSR_ARC_TRACKS];
+	uint8_t rec[SNRARC_MAXSIZE];
+};
+
+void snrarc_init(struct snrarc_builder * b, snrarc_complete_t complete, void * ctx);
+size_t snrarc_pack(const struct nrf_modem_gnss_pvt_data_frame * pvt, uint32_t utc, struct snrarc_epoch * epoch);
+void snrarc_update(struct snrarc_builder * b, const struct snrarc_epoch * epoch);
+
+#endif /* SNRARC_H */
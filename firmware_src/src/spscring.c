@@ -0,0 +1,77 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <string.h>
+#include <errno.h>
+#include "spscring.h"
+
+/* copy into the ring starting at (free running) position pos, wrapping around the end */
+static void ringcopyin(struct spscring * ring, uint32_t pos, const void * data, size_t len){
+	uint32_t offset=pos & (ring->size-1);
+	size_t nfirst=MIN(len,ring->size-offset);
+
+	memcpy(ring->buf+offset,data,nfirst);
+	memcpy(ring->buf,(const uint8_t *)data+nfirst,len-nfirst);
+}
+
+static void ringcopyout(const struct spscring * ring, uint32_t pos, void * data, size_t len){
+	uint32_t offset=pos & (ring->size-1);
+	size_t nfirst=MIN(len,ring->size-offset);
+
+	memcpy(data,ring->buf+offset,nfirst);
+	memcpy((uint8_t *)data+nfirst,ring->buf,len-nfirst);
+}
+
+/* number of bytes (including record headers) waiting to be read */
+uint32_t spscring_used(struct spscring * ring){
+	return (uint32_t)atomic_get(&ring->head)-(uint32_t)atomic_get(&ring->tail);
+}
+
+/* Append a record (producer only). Returns -ENOMEM and counts a drop when it does not fit */
+int spscring_put(struct spscring * ring, const void * data, size_t len){
+	if (len > UINT16_MAX){
+		ring->dropped++;
+		return -EINVAL;
+	}
+	uint32_t head=(uint32_t)atomic_get(&ring->head);
+	uint32_t used=head-(uint32_t)atomic_get(&ring->tail);
+	if (used+SPSCRING_HDRSIZE+len > ring->size){
+		ring->dropped++;
+		return -ENOMEM;
+	}
+
+	uint8_t hdr[SPSCRING_HDRSIZE]={len & 0xff,len >> 8};
+	ringcopyin(ring,head,hdr,SPSCRING_HDRSIZE);
+	ringcopyin(ring,head+SPSCRING_HDRSIZE,data,len);
+	/* publish the record only after its content is in place */
+	atomic_set(&ring->head,(atomic_val_t)(head+SPSCRING_HDRSIZE+len));
+
+	used+=SPSCRING_HDRSIZE+len;
+	ring->peak=MAX(ring->peak,used);
+	k_sem_give(ring->avail);
+	return 0;
+}
+
+/* Remove the oldest record and copy it to data (consumer only). Returns the length of the record,
+ * -EAGAIN when the ring is empty or -EMSGSIZE when the record was longer than maxlen (it is skipped) */
+int spscring_get(struct spscring * ring, void * data, size_t maxlen){
+	uint32_t tail=(uint32_t)atomic_get(&ring->tail);
+	if ((uint32_t)atomic_get(&ring->head) == tail){
+		return -EAGAIN;
+	}
+
+	uint8_t hdr[SPSCRING_HDRSIZE];
+	ringcopyout(ring,tail,hdr,SPSCRING_HDRSIZE);
+	size_t len=hdr[0] | (hdr[1] << 8);
+	int ret=-EMSGSIZE;
+	if (len <= maxlen){
+		ringcopyout(ring,tail+SPSCRING_HDRSIZE,data,len);
+		ret=len;
+	}
+	/* hand the space back to the producer only after the record was copied */
+	atomic_set(&ring->tail,(atomic_val_t)(tail+SPSCRING_HDRSIZE+len));
+	return ret;
+}
@@ -0,0 +1,49 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Lock-free ring buffer of variable length records, for one producer (e.g. a modem callback)
+ * and one consumer thread. Every record is stored as a 2 byte length followed by its data, so
+ * short messages take little more room than their content.
+ */
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <stdint.h>
+
+#define SPSCRING_HDRSIZE 2
+
+struct spscring {
+	uint8_t * buf;
+	uint32_t size; /* size of buf, a power of 2 */
+	atomic_t head; /* number of bytes written since the start (only changed by the producer) */
+	atomic_t tail; /* number of bytes read since the start (only changed by the consumer) */
+	struct k_sem * avail; /* given for every record which is put in the ring */
+	uint32_t peak; /* most bytes in use at the same time */
+	uint32_t dropped; /* records which did not fit */
+};
+
+/* define a ring of nbytes and a semaphore which can be polled for available records */
+#define SPSCRING_DEFINE(name, nbytes) \
+	BUILD_ASSERT(((nbytes) & ((nbytes)-1)) == 0, "size of an spscring must be a power of 2"); \
+	static uint8_t __aligned(4) _spscring_buf_##name[nbytes]; \
+	K_SEM_DEFINE(name##_avail, 0, K_SEM_MAX_LIMIT); \
+	struct spscring name={.buf=_spscring_buf_##name,.size=(nbytes),.head=ATOMIC_INIT(0),.tail=ATOMIC_INIT(0), \
+		.avail=&name##_avail,.peak=0,.dropped=0}
+
+/* access a ring defined in another file */
+#define SPSCRING_DECLARE(name) \
+	extern struct k_sem name##_avail; \
+	extern struct spscring name
+
+int spscring_put(struct spscring * ring, const void * data, size_t len);
+int spscring_get(struct spscring * ring, void * data, size_t maxlen);
+uint32_t spscring_used(struct spscring * ring);
+
+#endif /* SPSCRING_H */
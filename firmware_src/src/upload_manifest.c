@@ -0,0 +1,372 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <stdio.h>
+#include <string.h>
+#include "featherw_datalogger.h"
+#include "upload_manifest.h"
+#define XXH_STATIC_LINKING_ONLY
+#include "xxhash.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(GNSSR,CONFIG_GNSSR_LOG_LEVEL);
+
+#define MANIFEST_FILE "uploads.txt"
+#define MANIFEST_TMPFILE "uploads.txt.tmp"
+/* longest record: type, name, size, hash and attempts */
+#define MANIFEST_LINE_LEN (MANIFEST_NAME_LEN+32)
+
+static struct {
+	struct manifest_entry entries[CONFIG_GNSSR_UPLOAD_MANIFEST_SIZE];
+	int count;
+	uint32_t nrecords; /* in the manifest file */
+	bool torn; /* the manifest file ends with an incomplete record */
+	bool overflow; /* files were not queued, the data directory needs to be scanned again */
+} manifest;
+
+/* shared by reading the manifest and hashing files */
+static char readbuf[512];
+
+static const char * manifest_name(const char * path){
+	const char * name=strrchr(path,'/');
+	return (name != NULL) ? name+1 : path;
+}
+
+static int find(const char * name){
+	for (int i=0;i<manifest.count;i++){
+		if (strcmp(manifest.entries[i].name,name) == 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* update the pending files with a record (from the manifest file or a new one) */
+static int apply(char type, const char * name, uint32_t size, uint32_t hash, uint16_t attempts){
+	int i=find(name);
+	switch (type){
+		case 'A':
+			if (i < 0){
+				if (manifest.count == CONFIG_GNSSR_UPLOAD_MANIFEST_SIZE){
+					return MANIFEST_ERR_FULL;
+				}
+				i=manifest.count++;
+				strcpy(manifest.entries[i].name,name);
+			}
+			manifest.entries[i].size=size;
+			manifest.entries[i].hash=hash;
+			manifest.entries[i].attempts=attempts;
+			return MANIFEST_SUCCESS;
+		case 'F':
+			if (i < 0){
+				return MANIFEST_ERR_NOTFOUND;
+			}
+			manifest.entries[i].attempts++;
+			return MANIFEST_SUCCESS;
+		case 'D':
+			if (i < 0){
+				return MANIFEST_ERR_NOTFOUND;
+			}
+			/* keep the order in which the files were added */
+			memmove(&manifest.entries[i],&manifest.entries[i+1],(manifest.count-i-1)*sizeof(manifest.entries[0]));
+			manifest.count--;
+			return MANIFEST_SUCCESS;
+		default:
+			return MANIFEST_ERR_NOTFOUND;
+	}
+}
+
+static int format_entry(char * line, const struct manifest_entry * entry){
+	return snprintf(line,MANIFEST_LINE_LEN,"A %s %u %08x %u\n",entry->name,(unsigned)entry->size,(unsigned)entry->hash,
+			(unsigned)entry->attempts);
+}
+
+/* append a record to the manifest file */
+static int append(const char * line){
+	char path[100];
+	struct fs_file_t fid;
+	fs_file_t_init(&fid);
+	get_sd_config_path(path,MANIFEST_FILE);
+	if (fs_open(&fid,path,FS_O_WRITE|FS_O_CREATE|FS_O_APPEND) != 0){
+		LOG_ERR("Cannot open upload manifest %s",path);
+		return MANIFEST_ERR_IO;
+	}
+	if (manifest.torn){
+		/* start on a new line after an incomplete record */
+		if (fs_write(&fid,"\n",1) == 1){
+			manifest.torn=false;
+		}
+	}
+	size_t len=strlen(line);
+	ssize_t nwritten=fs_write(&fid,line,len);
+	fs_close(&fid);
+	if (nwritten != (ssize_t)len){
+		LOG_ERR("Cannot write to upload manifest %s",path);
+		return MANIFEST_ERR_IO;
+	}
+	manifest.nrecords++;
+	return MANIFEST_SUCCESS;
+}
+
+/* a record which changes a pending file */
+static int record(char type, const char * name){
+	char line[MANIFEST_LINE_LEN];
+	if (apply(type,name,0,0,0) != MANIFEST_SUCCESS){
+		return MANIFEST_ERR_NOTFOUND;
+	}
+	snprintf(line,sizeof(line),"%c %s\n",type,name);
+	return append(line);
+}
+
+/* record that files were not queued, so that the data directory is scanned again (also after a restart) */
+static void set_overflow(void){
+	if (!manifest.overflow){
+		manifest.overflow=true;
+		append("O\n");
+	}
+}
+
+int manifest_add(const char * path, size_t size, uint32_t hash){
+	char line[MANIFEST_LINE_LEN];
+	const char * name=manifest_name(path);
+	if (strlen(name) >= MANIFEST_NAME_LEN){
+		LOG_ERR("File name %s is too long for the upload manifest",name);
+		return MANIFEST_ERR_FULL;
+	}
+	int stat=apply('A',name,size,hash,0);
+	if (stat != MANIFEST_SUCCESS){
+		LOG_WRN("Upload manifest is full, %s is queued with the next scan of the data directory",name);
+		set_overflow();
+		return stat;
+	}
+	format_entry(line,&manifest.entries[find(name)]);
+	return append(line);
+}
+
+int manifest_add_file(const char * path){
+	struct fs_file_t fid;
+	XXH32_state_t xxh;
+	size_t size=0;
+	ssize_t nread;
+
+	fs_file_t_init(&fid);
+	if (fs_open(&fid,path,FS_O_READ) != 0){
+		LOG_ERR("Cannot open %s to queue it for uploading",path);
+		return MANIFEST_ERR_IO;
+	}
+	XXH32_reset(&xxh,0);
+	while ((nread=fs_read(&fid,readbuf,sizeof(readbuf))) > 0){
+		XXH32_update(&xxh,readbuf,nread);
+		size+=nread;
+	}
+	fs_close(&fid);
+	if (nread < 0){
+		LOG_ERR("Cannot read %s to queue it for uploading",path);
+		return MANIFEST_ERR_IO;
+	}
+	return manifest_add(path,size,XXH32_digest(&xxh));
+}
+
+int manifest_done(const char * name){
+	return record('D',name);
+}
+
+int manifest_failed(const char * name){
+	return record('F',name);
+}
+
+bool manifest_overflow(void){
+	return manifest.overflow;
+}
+
+int manifest_count(void){
+	return manifest.count;
+}
+
+const struct manifest_entry * manifest_get(int i){
+	return (i >= 0 && i < manifest.count) ? &manifest.entries[i] : NULL;
+}
+
+/* Rewrite the manifest file with only the pending files. The new manifest is written aside and
+ * renamed, so one of both is complete at any time */
+static int rewrite(void){
+	char path[100];
+	char pathtmp[100];
+	char line[MANIFEST_LINE_LEN];
+	struct fs_file_t fid;
+
+	get_sd_config_path(path,MANIFEST_FILE);
+	get_sd_config_path(pathtmp,MANIFEST_TMPFILE);
+	fs_file_t_init(&fid);
+	fs_unlink(pathtmp);
+	if (fs_open(&fid,pathtmp,FS_O_WRITE|FS_O_CREATE) != 0){
+		return MANIFEST_ERR_IO;
+	}
+	int stat=MANIFEST_SUCCESS;
+	for (int i=0;i<manifest.count && stat == MANIFEST_SUCCESS;i++){
+		int len=format_entry(line,&manifest.entries[i]);
+		if (fs_write(&fid,line,len) != len){
+			stat=MANIFEST_ERR_IO;
+		}
+	}
+	fs_close(&fid);
+	if (stat != MANIFEST_SUCCESS || fs_rename(pathtmp,path) != 0){
+		LOG_ERR("Cannot compact upload manifest %s",path);
+		return MANIFEST_ERR_IO;
+	}
+	LOG_INF("Compacted upload manifest from %u to %d records",manifest.nrecords,manifest.count);
+	manifest.nrecords=manifest.count;
+	manifest.torn=false;
+	return MANIFEST_SUCCESS;
+}
+
+/* rewrite the manifest once most of its records are about finished files */
+int manifest_compact(void){
+	/* keep the overflow record until the missing files are queued */
+	if (manifest.overflow || manifest.nrecords < 2*(uint32_t)manifest.count+32){
+		return MANIFEST_SUCCESS;
+	}
+	return rewrite();
+}
+
+/* queue the files of the data directory which were not uploaded yet (the ones without _ok suffix)
+ * and are not queued already, until the queue is full */
+static int scan(void){
+	static const char * suffixes[]={".lz4",".idx"};
+	char datadir[50];
+	char name[MANIFEST_NAME_LEN];
+	char path[100];
+	struct fs_dir_t dirp;
+	bool full=false;
+
+	(void)get_sd_data_path(datadir,NULL);
+	for (int i=0;i<ARRAY_SIZE(suffixes) && !full;i++){
+		fs_dir_t_init(&dirp);
+		if (lsdir_init(datadir,&dirp) != 0){
+			return MANIFEST_ERR_IO;
+		}
+		while (lsdir_next(suffixes[i],&dirp,name,sizeof(name)) == 0){
+			if (find(name) >= 0){
+				continue;
+			}
+			if (manifest.count == CONFIG_GNSSR_UPLOAD_MANIFEST_SIZE){
+				full=true;
+				break;
+			}
+			(void)get_sd_data_path(path,name);
+			manifest_add_file(path);
+		}
+		(void)lsdir_close(&dirp);
+	}
+	if (full){
+		set_overflow();
+	}else if (manifest.overflow){
+		/* drop the overflow record, so that the directory is not scanned again after a restart */
+		manifest.overflow=false;
+		if (rewrite() != MANIFEST_SUCCESS){
+			return MANIFEST_ERR_IO;
+		}
+	}
+	return full ? MANIFEST_ERR_FULL : MANIFEST_SUCCESS;
+}
+
+/* queue the files which did not fit in the queue before, once uploads have made room for them */
+int manifest_rescan(void){
+	if (!manifest.overflow || manifest.count == CONFIG_GNSSR_UPLOAD_MANIFEST_SIZE){
+		return MANIFEST_SUCCESS;
+	}
+	LOG_INF("Upload manifest was full, scanning the data directory");
+	return scan();
+}
+
+static int migrate(void){
+	LOG_INF("No upload manifest found, scanning the data directory");
+	int stat=scan();
+	if (stat == MANIFEST_ERR_IO){
+		return stat;
+	}
+	if (manifest.nrecords == 0){
+		/* an empty manifest, so that the directory is not scanned again */
+		char manifestpath[100];
+		struct fs_file_t fid;
+		fs_file_t_init(&fid);
+		get_sd_config_path(manifestpath,MANIFEST_FILE);
+		if (fs_open(&fid,manifestpath,FS_O_WRITE|FS_O_CREATE) != 0){
+			return MANIFEST_ERR_IO;
+		}
+		fs_close(&fid);
+	}
+	return MANIFEST_SUCCESS;
+}
+
+/* read the pending files from the manifest (or create it) */
+int manifest_load(void){
+	char path[100];
+	char pathtmp[100];
+	char line[MANIFEST_LINE_LEN];
+	struct fs_file_t fid;
+	struct fs_reader rd;
+
+	manifest.count=0;
+	manifest.nrecords=0;
+	manifest.torn=false;
+	manifest.overflow=false;
+	get_sd_config_path(path,MANIFEST_FILE);
+	get_sd_config_path(pathtmp,MANIFEST_TMPFILE);
+	if (!file_exists(path) && file_exists(pathtmp)){
+		/* interrupted while compacting */
+		fs_rename(pathtmp,path);
+	}
+	if (!file_exists(path)){
+		return migrate();
+	}
+
+	fs_file_t_init(&fid);
+	if (fs_open(&fid,path,FS_O_READ) != 0){
+		LOG_ERR("Cannot open upload manifest %s",path);
+		return MANIFEST_ERR_IO;
+	}
+	fs_reader_init(&rd,&fid,readbuf,sizeof(readbuf));
+	ssize_t len;
+	uint32_t nfull=0;
+	while ((len=fs_reader_gets(&rd,line,sizeof(line))) > 0){
+		char type;
+		char name[MANIFEST_NAME_LEN];
+		unsigned size=0;
+		unsigned hash=0;
+		unsigned attempts=0;
+		manifest.nrecords++;
+		/* skip a record which was not completely written (or is too long) */
+		manifest.torn=(line[len-1] != '\n');
+		if (manifest.torn){
+			continue;
+		}
+		if (line[0] == 'O'){
+			manifest.overflow=true;
+			continue;
+		}
+		int nfields=sscanf(line,"%c %63s %u %x %u",&type,name,&size,&hash,&attempts);
+		if (nfields < 2 || (type == 'A' && nfields < 5)){
+			continue;
+		}
+		if (apply(type,name,size,hash,attempts) == MANIFEST_ERR_FULL){
+			nfull++;
+		}
+	}
+	fs_close(&fid);
+	if (len < 0){
+		LOG_ERR("Cannot read upload manifest %s",path);
+		return MANIFEST_ERR_IO;
+	}
+	if (nfull > 0){
+		LOG_WRN("Upload manifest is full, %u files are queued with the next scan of the data directory",nfull);
+		set_overflow();
+	}
+	LOG_INF("%d files waiting for upload (%u records in the manifest)",manifest.count,manifest.nrecords);
+	return MANIFEST_SUCCESS;
+}
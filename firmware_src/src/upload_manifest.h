@@ -0,0 +1,60 @@
+/*
+* Copyright (c) 2026 Roelof Rietbroek <r.rietbroek@utwente.nl>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+ * Manifest of the data files which still need to be uploaded (CONFIG_GNSSR_UPLOAD_MANIFEST), so
+ * that an upload round only visits the pending files instead of listing the data directory with
+ * all files uploaded so far. The manifest is an append-only text file in the config directory
+ * (uploads.txt) with one record per line:
+ *
+ *   A <name> <size> <hash> <attempts>   a file was added (closed or recovered)
+ *   F <name>                            an upload of the file failed
+ *   D <name>                            the file was uploaded (or has disappeared)
+ *   O                                   files were not queued because the queue was full
+ *
+ * The hash is the XXH32 (seed 0, hexadecimal) of the file. The pending files are kept in memory;
+ * when the manifest holds mostly finished files it is rewritten with only the pending ones. When
+ * files do not fit in memory, they are picked up by scanning the data directory again
+ * (manifest_rescan) once uploads have made room for them.
+ * Without a manifest (e.g. on a card written by older firmware) the data directory is scanned
+ * once for files which were not uploaded yet.
+ */
+
+#ifndef UPLOAD_MANIFEST_H
+#define UPLOAD_MANIFEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MANIFEST_SUCCESS 0
+#define MANIFEST_ERR_IO -1
+#define MANIFEST_ERR_FULL -2
+#define MANIFEST_ERR_NOTFOUND -3
+
+#define MANIFEST_NAME_LEN 64
+
+struct manifest_entry {
+	char name[MANIFEST_NAME_LEN]; /* in the data directory */
+	uint32_t size;
+	uint32_t hash;
+	uint16_t attempts; /* failed uploads */
+};
+
+int manifest_load(void);
+/* queue a file of the data directory, with the size and hash known from writing it */
+int manifest_add(const char * path, size_t size, uint32_t hash);
+/* queue a file of the data directory, which is read to compute its hash */
+int manifest_add_file(const char * path);
+int manifest_done(const char * name);
+int manifest_failed(const char * name);
+int manifest_compact(void);
+int manifest_rescan(void);
+bool manifest_overflow(void);
+int manifest_count(void);
+const struct manifest_entry * manifest_get(int i);
+
+#endif /* UPLOAD_MANIFEST_H */